@@ -0,0 +1,149 @@
+/*
+Checks that every SIMD path of the ddeutil pixel kernels matches the
+scalar code bit for bit, then times each path on a 1080p frame. The
+kernels are static, so this file includes ddeutil.cpp. From this
+directory:
+
+	gcc -O2 -c stub_core.c
+	g++ -std=c++11 -O2 -I.. bench_kernels.cpp stub_core.o -lpthread -o bench_kernels
+	./bench_kernels
+
+The kernels build the luminance planes of ddeutil frames, which the
+motion gate and `ddeutil_frame_get_gray` callers read, and the 32-bit
+copies of 24-bit images handed to dde_core. The detection cascade
+inside dde_core scans its own pyramid and is not affected.
+*/
+#include "../ddeutil.cpp"
+#include <cstdio>
+
+#define KERNEL_MAX_W 300
+#define FRAME_W 1920
+#define FRAME_H 1080
+#define TIMING_RUNS 20
+
+typedef void (*RowFunc)(unsigned char* dst,const unsigned char* src,int n);
+typedef void (*PairFunc)(unsigned char* dst,const unsigned char* s0,const unsigned char* s1,int n);
+
+#ifdef DDEUTIL_X86
+// the SSSE3 kernel leaves the last pixels to its caller
+static void expand_row_c3_ssse3_full(unsigned char* dst,const unsigned char* src,int n){
+	int x=expand_row_c3_ssse3(dst,src,n);
+	expand_row_c3_scalar(dst+x*4,src+x*3,n-x);
+}
+#endif
+
+struct RowKernel{
+	const char* name;
+	int src_bpp,dst_bpp;
+	RowFunc isa[3];
+};
+
+struct PairKernel{
+	const char* name;
+	PairFunc isa[3];
+};
+
+static const char* const g_isa_names[3]={"scalar","ssse3","avx2"};
+
+#ifdef DDEUTIL_X86
+static const RowKernel g_row_kernels[]={
+	{"gray_row_c3",3,1,{gray_row_c3_scalar,gray_row_c3_ssse3,gray_row_c3_avx2}},
+	{"gray_row_c4",4,1,{gray_row_c4_scalar,gray_row_c4_ssse3,gray_row_c4_avx2}},
+	{"expand_row_c3",3,4,{expand_row_c3_scalar,expand_row_c3_ssse3_full,NULL}},
+};
+static const PairKernel g_pair_kernels[]={
+	{"downsample_row",{downsample_row_scalar,downsample_row_ssse3,downsample_row_avx2}},
+};
+#else
+static const RowKernel g_row_kernels[]={
+	{"gray_row_c3",3,1,{gray_row_c3_scalar,NULL,NULL}},
+	{"gray_row_c4",4,1,{gray_row_c4_scalar,NULL,NULL}},
+	{"expand_row_c3",3,4,{expand_row_c3_scalar,NULL,NULL}},
+};
+static const PairKernel g_pair_kernels[]={
+	{"downsample_row",{downsample_row_scalar,NULL,NULL}},
+};
+#endif
+
+static unsigned int g_rng=0x9e3779b9u;
+
+static void fill_random(std::vector<unsigned char>& buf){
+	for(size_t i=0;i<buf.size();i++){
+		g_rng^=g_rng<<13;
+		g_rng^=g_rng>>17;
+		g_rng^=g_rng<<5;
+		buf[i]=(unsigned char)(g_rng>>24);
+	}
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point t0){
+	return std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-t0).count();
+}
+
+int main(){
+	int n_failures=0;
+	printf("isa picked at load time: %s\n",g_isa_names[g_isa]);
+	for(size_t k=0;k<sizeof(g_row_kernels)/sizeof(g_row_kernels[0]);k++){
+		const RowKernel& kernel=g_row_kernels[k];
+		// the reference output and the output under test, with a guard byte past the end
+		std::vector<unsigned char> src(KERNEL_MAX_W*kernel.src_bpp),ref(KERNEL_MAX_W*kernel.dst_bpp+1),out(ref.size());
+		std::vector<unsigned char> frame_src((size_t)FRAME_W*FRAME_H*kernel.src_bpp),frame_dst((size_t)FRAME_W*FRAME_H*kernel.dst_bpp);
+		fill_random(frame_src);
+		for(int isa=0;isa<=g_isa;isa++){
+			RowFunc f=kernel.isa[isa];
+			if(!f) continue;
+			int mismatches=0;
+			for(int n=1;n<=KERNEL_MAX_W;n++){
+				fill_random(src);
+				ref[(size_t)n*kernel.dst_bpp]=out[(size_t)n*kernel.dst_bpp]=0x5a;
+				kernel.isa[0](&ref[0],&src[0],n);
+				f(&out[0],&src[0],n);
+				if(memcmp(&ref[0],&out[0],(size_t)n*kernel.dst_bpp+1)!=0) mismatches++;
+			}
+			double best=1e30;
+			for(int run=0;run<TIMING_RUNS;run++){
+				std::chrono::steady_clock::time_point t0=std::chrono::steady_clock::now();
+				for(int y=0;y<FRAME_H;y++){
+					f(&frame_dst[(size_t)y*FRAME_W*kernel.dst_bpp],&frame_src[(size_t)y*FRAME_W*kernel.src_bpp],FRAME_W);
+				}
+				double ms=elapsed_ms(t0);
+				if(ms<best) best=ms;
+			}
+			printf("%-16s %-7s %s, %.3f ms per 1080p frame\n",kernel.name,g_isa_names[isa],mismatches?"MISMATCH":"bit-exact",best);
+			if(mismatches) n_failures++;
+		}
+	}
+	for(size_t k=0;k<sizeof(g_pair_kernels)/sizeof(g_pair_kernels[0]);k++){
+		const PairKernel& kernel=g_pair_kernels[k];
+		std::vector<unsigned char> s0(KERNEL_MAX_W*2),s1(KERNEL_MAX_W*2),ref(KERNEL_MAX_W+1),out(KERNEL_MAX_W+1);
+		std::vector<unsigned char> frame_src((size_t)FRAME_W*FRAME_H),frame_dst((size_t)(FRAME_W/2)*(FRAME_H/2));
+		fill_random(frame_src);
+		for(int isa=0;isa<=g_isa;isa++){
+			PairFunc f=kernel.isa[isa];
+			if(!f) continue;
+			int mismatches=0;
+			for(int n=1;n<=KERNEL_MAX_W;n++){
+				fill_random(s0);
+				fill_random(s1);
+				ref[n]=out[n]=0x5a;
+				kernel.isa[0](&ref[0],&s0[0],&s1[0],n);
+				f(&out[0],&s0[0],&s1[0],n);
+				if(memcmp(&ref[0],&out[0],(size_t)n+1)!=0) mismatches++;
+			}
+			double best=1e30;
+			for(int run=0;run<TIMING_RUNS;run++){
+				std::chrono::steady_clock::time_point t0=std::chrono::steady_clock::now();
+				for(int y=0;y<FRAME_H/2;y++){
+					const unsigned char* row=&frame_src[(size_t)(2*y)*FRAME_W];
+					f(&frame_dst[(size_t)y*(FRAME_W/2)],row,row+FRAME_W,FRAME_W/2);
+				}
+				double ms=elapsed_ms(t0);
+				if(ms<best) best=ms;
+			}
+			printf("%-16s %-7s %s, %.3f ms per 1080p frame\n",kernel.name,g_isa_names[isa],mismatches?"MISMATCH":"bit-exact",best);
+			if(mismatches) n_failures++;
+		}
+	}
+	printf("%d failures\n",n_failures);
+	return n_failures?1:0;
+}
@@ -0,0 +1,121 @@
+/*
+Runs the ddeutil probes against the stub core, or against dde_core
+when linked with it instead of stub_core.c. From this directory:
+
+	gcc -O2 -c stub_core.c
+	g++ -std=c++11 -O2 -I.. bench_main.cpp ddeutil_probes.cpp ../ddeutil.cpp stub_core.o -lpthread -o bench
+	./bench
+
+With the stub, the tracker outputs are synthetic, so the figures
+measure ddeutil itself: its allocations and the time it spends
+around the core calls.
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "../ddeutil.h"
+#include "ddeutil_probes.h"
+#include "stub_core.h"
+
+#define BENCH_W 640
+#define BENCH_H 480
+
+static int g_failures=0;
+
+static void check(const char* name,int ok){
+	printf("%-40s %s\n",name,ok?"ok":"FAILED");
+	if(!ok) g_failures++;
+}
+
+// The session of the allocation figures, every optional stage turned on
+static void bench_steady_state(std::vector<unsigned char>& img){
+	ddeutil_session* s=ddeutil_session_create(4);
+	ddeutil_session_set_n_threads(s,2);
+	ddeutil_session_set_n_copies(s,1,3);
+	ddeutil_session_set_motion_gate(s,8,3,5);
+	ddeutil_detector* d=ddeutil_session_get_detector(s);
+	float v=2.f;
+	ddeutil_detector_set(d,"n_threads",&v);
+	v=0.25f;
+	ddeutil_detector_set(d,"scan_fraction",&v);
+	v=100000.f;
+	ddeutil_detector_set(d,"time_budget_us",&v);
+	for(int f=0;f<20;f++) ddeutil_session_run(s,NULL,&img[0],BENCH_W*4,BENCH_W,BENCH_H,FLAG_IMAGE_FORMAT_RGBA);
+	unsigned int count=ddeutil_get_alloc_count();
+	for(int f=0;f<100;f++){
+		// a little noise, so that the motion gate lets some scans through
+		img[(size_t)f*997%img.size()]^=0xff;
+		ddeutil_session_run(s,NULL,&img[0],BENCH_W*4,BENCH_W,BENCH_H,FLAG_IMAGE_FORMAT_RGBA);
+	}
+	unsigned int allocs=ddeutil_get_alloc_count()-count;
+	printf("steady state: %u allocations in 100 frames, faces 0x%x\n",allocs,ddeutil_session_hasface(s));
+	check("steady state allocates nothing",allocs==0);
+	ddeutil_session_destroy(s);
+}
+
+// Gray frames, the detector takes them with "is_mono" and the tracker as 32-bit pixels
+static void bench_grayscale(){
+	std::vector<unsigned char> gray((size_t)BENCH_W*BENCH_H,50);
+	stub_core_set_image(&gray[0],BENCH_W,1);
+	int errors=stub_core_layout_errors();
+	ddeutil_session* s=ddeutil_session_create(4);
+	for(int f=0;f<20;f++) ddeutil_session_run(s,NULL,&gray[0],BENCH_W,BENCH_W,BENCH_H,FLAG_IMAGE_FORMAT_GRAYSCALE);
+	int faces=ddeutil_session_hasface(s);
+	int roi[4];
+	int tracked=ddeutil_get_roi(ddeutil_session_get_context(s,0),0.5f,BENCH_W,BENCH_H,roi)&&
+		ddeutil_track_roi(ddeutil_session_get_context(s,0),&gray[(size_t)roi[1]*BENCH_W+roi[0]],BENCH_W,roi,BENCH_W,BENCH_H,FLAG_IMAGE_FORMAT_GRAYSCALE)>0;
+	ddeutil_session_destroy(s);
+	printf("grayscale: faces 0x%x\n",faces);
+	check("grayscale session finds the faces",faces==0xf);
+	check("grayscale window tracked",tracked);
+	check("grayscale passed in a layout the core reads",stub_core_layout_errors()==errors);
+}
+
+// A face only a side detector finds upside down, the case the schedules differ on most
+static void bench_first_face(){
+	std::vector<unsigned char> img((size_t)BENCH_W*BENCH_H*4,50);
+	stub_core_set_image(&img[0],BENCH_W*4,4);
+	stub_core_clear_faces();
+	stub_core_add_face(260,180,100,2,DETECTOR_TYPE_RIGHT_SIDE_FACE);
+	static const char* const names[]={"sweep","random"};
+	for(int schedule=DDEUTIL_SCHEDULE_SWEEP;schedule<=DDEUTIL_SCHEDULE_RANDOM;schedule++){
+		double r[4];
+		if(ddeutil_probe_first_face(&img[0],BENCH_W*4,BENCH_W,BENCH_H,FLAG_IMAGE_FORMAT_RGBA,schedule,200,400,r)<0) continue;
+		printf("first face, %s: mean %.1f max %.0f frames, again: mean %.1f max %.0f frames\n",names[schedule],r[0],r[1],r[2],r[3]);
+	}
+}
+
+int main(){
+	std::vector<unsigned char> img((size_t)BENCH_W*BENCH_H*4,50);
+	stub_core_set_image(&img[0],BENCH_W*4,4);
+	stub_core_add_face(40,40,96,-1,-1);
+	stub_core_add_face(240,60,96,-1,-1);
+	stub_core_add_face(440,80,96,-1,-1);
+	stub_core_add_face(200,300,120,-1,-1);
+	float rect[4]={40.f,40.f,136.f,136.f};
+
+	int reentrant=ddeutil_probe_reentrancy(&img[0],BENCH_W*4,BENCH_W,BENCH_H,rect,32,10);
+	check("tracker reentrant across contexts",reentrant==1);
+
+	size_t layout[4];
+	if(ddeutil_probe_context_layout(&img[0],BENCH_W*4,BENCH_W,BENCH_H,rect,10,layout)>0){
+		printf("context layout: %u bytes, tracker writes %u in %u bytes of lines, optical flow only %u\n",
+			(unsigned int)layout[0],(unsigned int)layout[1],(unsigned int)layout[3],(unsigned int)layout[2]);
+	}
+
+	bench_steady_state(img);
+	bench_grayscale();
+	stub_core_set_image(&img[0],BENCH_W*4,4);
+
+	double churn[4];
+	if(ddeutil_probe_churn(&img[0],BENCH_W*4,BENCH_W,BENCH_H,FLAG_IMAGE_FORMAT_RGBA,4,200,3,churn)>0){
+		printf("churn: mean %.1fus max %.1fus, %.0f allocations, %.0f faces entered\n",churn[0],churn[1],churn[2],churn[3]);
+		check("churn allocates nothing",churn[2]==0.0);
+	}
+
+	bench_first_face();
+
+	check("core calls with the right pixel layout",stub_core_layout_errors()==0);
+	printf("%d detector calls, %d failures\n",stub_core_detector_calls(),g_failures);
+	return g_failures?1:0;
+}
@@ -0,0 +1,163 @@
+#include "ddeutil_probes.h"
+#include <string.h>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+// the size of a cache line on the targets we ship for
+#define PROBE_CACHE_LINE 64
+
+static const char* const g_probe_outputs[]={"rotation","translation","expression","identity","landmarks"};
+
+// Tracks one context for n_frames and appends its outputs to *out
+static void probe_run(TWorkArea* ctx,const void* img,int stride,int w,int h,const float* rect,int n_frames,std::vector<float>* out){
+	dde_init_context_ex(ctx,rect,w,h,0,NULL);
+	for(int f=0;f<n_frames;f++){
+		out->push_back((float)hldde_next(ctx,(void*)img,stride,w,h));
+		for(size_t k=0;k<sizeof(g_probe_outputs)/sizeof(g_probe_outputs[0]);k++){
+			int dim=0;
+			float* p=dde_get(ctx,g_probe_outputs[k],&dim);
+			if(p&&dim>0) out->insert(out->end(),p,p+dim);
+		}
+	}
+}
+
+int ddeutil_probe_reentrancy(const void* img,int stride,int w,int h,const float* rect,int n_contexts,int n_frames){
+	if(n_contexts<1) return -1;
+	std::vector<TWorkArea*> contexts;
+	for(int i=0;i<n_contexts;i++){
+		TWorkArea* ctx=(TWorkArea*)dde_create_context();
+		if(!ctx) break;
+		contexts.push_back(ctx);
+	}
+	int ret=-1;
+	if((int)contexts.size()==n_contexts){
+		std::vector<std::vector<float> > serial(contexts.size()),parallel(contexts.size());
+		for(size_t i=0;i<contexts.size();i++) probe_run(contexts[i],img,stride,w,h,rect,n_frames,&serial[i]);
+		std::vector<std::thread> threads;
+		for(size_t i=0;i<contexts.size();i++){
+			threads.push_back(std::thread(probe_run,contexts[i],img,stride,w,h,rect,n_frames,&parallel[i]));
+		}
+		for(size_t i=0;i<threads.size();i++) threads[i].join();
+		ret=1;
+		for(size_t i=0;i<contexts.size();i++){
+			// compare the bits, a NaN in both runs is still a match
+			if(serial[i].size()!=parallel[i].size()||
+			(!serial[i].empty()&&memcmp(&serial[i][0],&parallel[i][0],serial[i].size()*sizeof(float))!=0)){
+				ret=0;
+			}
+		}
+	}
+	for(size_t i=0;i<contexts.size();i++) dde_destroy_context(contexts[i]);
+	return ret;
+}
+
+// Marks the bytes of the context that differ from *prev, then updates *prev
+static void probe_mark_writes(const TWorkArea* ctx,std::vector<unsigned char>* prev,std::vector<unsigned char>* written){
+	const unsigned char* p=(const unsigned char*)ctx;
+	for(size_t i=0;i<prev->size();i++){
+		if(p[i]!=(*prev)[i]) (*written)[i]=1;
+	}
+	memcpy(&(*prev)[0],p,prev->size());
+}
+
+int ddeutil_probe_context_layout(const void* img,int stride,int w,int h,const float* rect,int n_frames,size_t* ret){
+	size_t size=dde_context_size();
+	TWorkArea* ctx=(TWorkArea*)dde_create_context();
+	if(!ctx) return -1;
+	std::vector<unsigned char> prev(size),tracked(size),flow(size);
+	dde_init_context_ex(ctx,rect,w,h,0,NULL);
+	memcpy(&prev[0],ctx,size);
+	for(int f=0;f<n_frames;f++){
+		hldde_next(ctx,(void*)img,stride,w,h);
+		probe_mark_writes(ctx,&prev,&tracked);
+		ddear_run_optical_flow(ctx,img,stride,w,h,0);
+		probe_mark_writes(ctx,&prev,&flow);
+	}
+	dde_destroy_context(ctx);
+	size_t n_tracked=0,n_flow=0,n_lines=0;
+	for(size_t i=0;i<size;i++){
+		if(tracked[i]) n_tracked++;
+		if(flow[i]&&!tracked[i]) n_flow++;
+	}
+	for(size_t line=0;line<size;line+=PROBE_CACHE_LINE){
+		size_t end=line+PROBE_CACHE_LINE<size?line+PROBE_CACHE_LINE:size;
+		for(size_t i=line;i<end;i++){
+			if(tracked[i]){
+				n_lines++;
+				break;
+			}
+		}
+	}
+	ret[0]=size;
+	ret[1]=n_tracked;
+	ret[2]=n_flow;
+	ret[3]=n_lines*PROBE_CACHE_LINE;
+	return 1;
+}
+
+int ddeutil_probe_churn(const void* img,int stride,int w,int h,int flags,int max_faces,int n_frames,int period,double* ret){
+	ddeutil_session* s=ddeutil_session_create(max_faces);
+	if(!s) return -1;
+	if(period<1) period=1;
+	double total_us=0.0,max_us=0.0;
+	unsigned int allocs=0;
+	int n_entered=0;
+	for(int f=0;f<n_frames;f++){
+		// a face leaves, and comes back as a newcomer the detector has to find
+		unsigned int tracked=(unsigned int)ddeutil_session_hasface(s);
+		if(f%period==period-1&&tracked){
+			int face_id=0;
+			while(!(tracked&(1u<<face_id))) face_id++;
+			ddeutil_session_drop_face(s,face_id);
+		}
+		unsigned int before=(unsigned int)ddeutil_session_hasface(s);
+		unsigned int count=ddeutil_get_alloc_count();
+		std::chrono::steady_clock::time_point t0=std::chrono::steady_clock::now();
+		ddeutil_session_run(s,NULL,img,stride,w,h,flags);
+		double us=std::chrono::duration<double,std::micro>(std::chrono::steady_clock::now()-t0).count();
+		// the first frame allocates the frame buffers
+		if(f>0) allocs+=ddeutil_get_alloc_count()-count;
+		for(unsigned int entered=(unsigned int)ddeutil_session_hasface(s)&~before;entered;entered&=entered-1) n_entered++;
+		total_us+=us;
+		if(us>max_us) max_us=us;
+	}
+	ddeutil_session_destroy(s);
+	ret[0]=n_frames>0?total_us/(double)n_frames:0.0;
+	ret[1]=max_us;
+	ret[2]=(double)allocs;
+	ret[3]=(double)n_entered;
+	return 1;
+}
+
+// Runs s until it tracks a face, returns the number of frames it took
+static int probe_search(ddeutil_session* s,const void* img,int stride,int w,int h,int flags,int max_frames){
+	int n=0;
+	while(n<max_frames&&!ddeutil_session_hasface(s)){
+		ddeutil_session_run(s,NULL,img,stride,w,h,flags);
+		n++;
+	}
+	return n;
+}
+
+int ddeutil_probe_first_face(const void* img,int stride,int w,int h,int flags,int schedule,int n_seeds,int max_frames,double* ret){
+	double total[2]={0.0,0.0},max[2]={0.0,0.0};
+	for(int seed=1;seed<=n_seeds;seed++){
+		ddeutil_session* s=ddeutil_session_create(1);
+		if(!s) return -1;
+		ddeutil_session_set_schedule(s,schedule);
+		ddeutil_session_seed(s,(unsigned int)seed);
+		for(int k=0;k<2;k++){
+			double n=(double)probe_search(s,img,stride,w,h,flags,max_frames);
+			total[k]+=n;
+			if(n>max[k]) max[k]=n;
+			ddeutil_session_drop_face(s,0);
+		}
+		ddeutil_session_destroy(s);
+	}
+	for(int k=0;k<2;k++){
+		ret[2*k]=n_seeds>0?total[k]/(double)n_seeds:0.0;
+		ret[2*k+1]=max[k];
+	}
+	return 1;
+}
@@ -0,0 +1,108 @@
+#pragma once
+#ifndef DDEUTIL_PROBES_H
+#define DDEUTIL_PROBES_H
+#include "../ddeutil.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/***************************************************************
+Here go the probes behind the figures quoted for ddeutil. They are
+not part of the library: build them with the dde_core you ship
+with, or with `stub_core.c` to reproduce the stub figures, refer
+to `bench_main.cpp`. They only use the public ddeutil and dde_core
+functions.
+***************************************************************/
+
+/**
+\brief Check that the tracker is reentrant across distinct contexts.
+       `n_contexts` contexts are initialized from `rect` and tracked
+       for `n_frames` frames, first one after another on the calling
+       thread, then all at once with one thread per context. The
+       "rotation", "translation", "expression", "identity" and
+       "landmarks" outputs of both runs are compared bit by bit.
+       dde_core is called directly, not through the process-wide
+       lock of ddeutil, so no other thread may use dde_core meanwhile.
+\param img points to an image with a face in it, in a format
+       `hldde_next` accepts
+\param stride specifies the distance between a pixel and the pixel
+       on the next row, in bytes.
+\param w is the image width, in pixels
+\param h is the image height, in pixels
+\param rect is the face rectangle, refer to `dde_init_context_ex`
+\param n_contexts is the number of contexts and threads, e.g. 32
+\param n_frames is the number of tracker runs per context
+\return 1 when the concurrent results are bit-identical to the serial
+        ones, 0 when they differ, -1 when out of memory
+*/
+int ddeutil_probe_reentrancy(const void* img,int stride,int w,int h,const float* rect,int n_contexts,int n_frames);
+/**
+\brief Measure which part of a tracker context the tracker works on.
+       Tracks a face on an image for `n_frames` frames, running
+       `ddear_run_optical_flow` after each `hldde_next`, and records
+       which bytes of the context each of them writes. Bytes that are
+       only read are not seen, so the figures are lower bounds of the
+       hot state.
+\param img points to an image with a face, refer to `hldde_next`
+\param stride specifies the distance between a pixel and the pixel
+       on the next row, in bytes.
+\param w is the image width, in pixels
+\param h is the image height, in pixels
+\param rect is the face on the image, x0, y0, x1 and y1
+\param n_frames is the number of frames to track
+\param ret receives 4 sizes in bytes: `dde_context_size()`, the bytes
+       `hldde_next` writes, the bytes only `ddear_run_optical_flow`
+       writes, and the cache lines `hldde_next` writes to
+\return 1 on success, -1 when out of memory
+*/
+int ddeutil_probe_context_layout(const void* img,int stride,int w,int h,const float* rect,int n_frames,size_t* ret);
+/**
+\brief Measure a session under face churn. Runs a new session on
+       the same image for `n_frames` frames and drops a tracked face
+       every `period` frames, so that it has to be found and started
+       again while the others keep being tracked.
+\param img points to an image with faces, refer to
+       `ddeutil_session_run`
+\param stride specifies the distance between a pixel and the pixel
+       on the next row, in bytes.
+\param w is the image width, in pixels
+\param h is the image height, in pixels
+\param flags is passed to `ddeutil_session_run`
+\param max_faces is the maximum number of faces of the session
+\param n_frames is the number of frames to run
+\param period is the number of frames between two faces leaving
+\param ret receives 4 values: the mean and the maximum time of a
+       frame in microseconds, the allocations made after the first
+       frame, and the number of faces that entered
+\return 1 on success, -1 when out of memory
+*/
+int ddeutil_probe_churn(const void* img,int stride,int w,int h,int flags,int max_faces,int n_frames,int period,double* ret);
+/**
+\brief Measure how many frames a detector schedule takes to find a
+       face. For each seed, a new session runs on the same image
+       until it tracks a face, drops the face, and runs until it
+       finds the face again. The second search starts from the
+       orientation of the face that was found.
+\param img points to an image with one face, refer to
+       `ddeutil_session_run`
+\param stride specifies the distance between a pixel and the pixel
+       on the next row, in bytes.
+\param w is the image width, in pixels
+\param h is the image height, in pixels
+\param flags is passed to `ddeutil_session_run`
+\param schedule is DDEUTIL_SCHEDULE_SWEEP or DDEUTIL_SCHEDULE_RANDOM
+\param n_seeds is the number of sessions, seeded 1 to `n_seeds`
+\param max_frames is the number of frames after which a search gives
+       up, and counts as `max_frames`
+\param ret receives 4 values: the mean and the maximum number of
+       frames to the first face, then to finding it again
+\return 1 on success, -1 when out of memory
+*/
+int ddeutil_probe_first_face(const void* img,int stride,int w,int h,int flags,int schedule,int n_seeds,int max_frames,double* ret);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,209 @@
+#include "../ddeface.h"
+#include "stub_core.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define STUB_MAX_FACES 64
+#define STUB_N_LANDMARKS 75
+// the smallest window of a detector nobody set "size_min" on
+#define STUB_SIZE_MIN 24.f
+
+// the counters are bumped from the threads of ddeutil's pools
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define STUB_COUNT(counter) _InterlockedIncrement((volatile long*)&(counter))
+#else
+#define STUB_COUNT(counter) __sync_fetch_and_add(&(counter),1)
+#endif
+
+typedef struct{
+	int x,y,size;
+	int rotation_mode,detector_type;
+}StubFace;
+
+typedef struct{
+	float size_min,size_max,scaling_factor,is_mono;
+}StubDetector;
+
+typedef struct{
+	float rect[4];
+	float landmarks[STUB_N_LANDMARKS*2];
+	float stress;
+	float identity[N_IDENTITIES];
+	int frames;
+}StubContext;
+
+static StubFace g_faces[STUB_MAX_FACES];
+static int g_n_faces=0;
+static const unsigned char* g_image=NULL;
+static int g_image_stride=0,g_image_bpp=1;
+static long g_detector_calls=0;
+static long g_layout_errors=0;
+
+void stub_core_add_face(int x,int y,int size,int rotation_mode,int detector_type){
+	if(g_n_faces>=STUB_MAX_FACES) return;
+	g_faces[g_n_faces].x=x;
+	g_faces[g_n_faces].y=y;
+	g_faces[g_n_faces].size=size;
+	g_faces[g_n_faces].rotation_mode=rotation_mode;
+	g_faces[g_n_faces].detector_type=detector_type;
+	g_n_faces++;
+}
+
+void stub_core_clear_faces(){
+	g_n_faces=0;
+}
+
+void stub_core_set_image(const void* img,int stride,int bpp){
+	g_image=(const unsigned char*)img;
+	g_image_stride=stride;
+	g_image_bpp=bpp;
+}
+
+int stub_core_detector_calls(){
+	return g_detector_calls;
+}
+
+int stub_core_layout_errors(){
+	return g_layout_errors;
+}
+
+int dde_setup(const void* p, const void* authdata,int authdata_sz){
+	(void)p;
+	(void)authdata;
+	(void)authdata_sz;
+	return 1;
+}
+
+size_t dde_context_size(){
+	return sizeof(StubContext);
+}
+
+void* dde_facedet_create(){
+	StubDetector* d=(StubDetector*)calloc(1,sizeof(StubDetector));
+	if(d){
+		d->size_min=STUB_SIZE_MIN;
+		d->size_max=-1.f;
+		d->scaling_factor=1.2f;
+	}
+	return d;
+}
+
+void dde_facedet_destroy(void* detector){
+	free(detector);
+}
+
+int dde_facedet_set(void* detector,const char* name,const float* pvalue){
+	StubDetector* d=(StubDetector*)detector;
+	if(!strcmp(name,"size_min")) d->size_min=*pvalue;
+	if(!strcmp(name,"size_max")) d->size_max=*pvalue;
+	if(!strcmp(name,"scaling_factor")) d->scaling_factor=*pvalue;
+	if(!strcmp(name,"is_mono")) d->is_mono=*pvalue;
+	return 1;
+}
+
+// The windows grow by the scaling factor from size_min to size_max, and
+// one finds a face up to halfway to the next window size
+static int stub_window_fits(const StubDetector* d,float size_max,float size){
+	float scaling=d->scaling_factor>1.f?d->scaling_factor:1.2f;
+	float half_step=sqrtf(scaling);
+	for(float window=d->size_min>0.f?d->size_min:STUB_SIZE_MIN;window<=size_max;window*=scaling){
+		if(size>=window/half_step&&size<=window*half_step) return 1;
+	}
+	return 0;
+}
+
+int dde_facedet_run_ex2(void* detector,const void* img,int stride,int w,int h,int* ret,int max_faces,int rotation_mode,int detector_type){
+	StubDetector* d=(StubDetector*)detector;
+	STUB_COUNT(g_detector_calls);
+	if(stride<w*(d->is_mono!=0.f?1:4)){
+		STUB_COUNT(g_layout_errors);
+		return 0;
+	}
+	// place the call on the full image
+	int x0=0,y0=0;
+	if(g_image&&(const unsigned char*)img>=g_image&&g_image_stride>0){
+		size_t offset=(size_t)((const unsigned char*)img-g_image);
+		y0=(int)(offset/(size_t)g_image_stride);
+		x0=(int)(offset%(size_t)g_image_stride)/g_image_bpp;
+	}
+	float size_max=d->size_max>0.f?d->size_max:(float)(w<h?w:h);
+	int n=0;
+	for(int i=0;i<g_n_faces&&n<max_faces;i++){
+		const StubFace* f=&g_faces[i];
+		if(f->rotation_mode>=0&&f->rotation_mode!=rotation_mode) continue;
+		if(f->detector_type>=0&&f->detector_type!=detector_type) continue;
+		if(!stub_window_fits(d,size_max,(float)f->size)) continue;
+		// the whole face has to be inside the call
+		if(f->x<x0||f->y<y0||f->x+f->size>x0+w||f->y+f->size>y0+h) continue;
+		ret[n*4+0]=f->x-x0;
+		ret[n*4+1]=f->y-y0;
+		ret[n*4+2]=f->size;
+		ret[n*4+3]=f->size;
+		n++;
+	}
+	return n;
+}
+
+void dde_init_context_ex(TWorkArea* context,const float* rect,int w,int h,int rotation_mode,const float* pfl){
+	StubContext* c=(StubContext*)context;
+	(void)w;
+	(void)h;
+	(void)rotation_mode;
+	(void)pfl;
+	memcpy(c->rect,rect,sizeof(c->rect));
+	c->frames=0;
+	c->stress=0.f;
+}
+
+int hldde_next(TWorkArea* context, void* img,int stride,int w,int h){
+	StubContext* c=(StubContext*)context;
+	(void)img;
+	(void)h;
+	if(stride<w*4){
+		STUB_COUNT(g_layout_errors);
+		return 0;
+	}
+	c->frames++;
+	for(int i=0;i<STUB_N_LANDMARKS;i++){
+		c->landmarks[2*i]=c->rect[0]+(c->rect[2]-c->rect[0])*(float)(i%10)/9.f;
+		c->landmarks[2*i+1]=c->rect[1]+(c->rect[3]-c->rect[1])*(float)(i/10)/7.f;
+	}
+	for(int i=0;i<N_IDENTITIES;i++) c->identity[i]=0.1f*(float)i;
+	return 1;
+}
+
+float* dde_get(TWorkArea* context,const char* name,int* pdim){
+	StubContext* c=(StubContext*)context;
+	if(!strcmp(name,"landmarks")){
+		*pdim=STUB_N_LANDMARKS*2;
+		return c->landmarks;
+	}
+	if(!strcmp(name,"face_confirmation_failure_stress")){
+		*pdim=1;
+		return &c->stress;
+	}
+	if(!strcmp(name,"identity")){
+		*pdim=N_IDENTITIES;
+		return c->identity;
+	}
+	*pdim=4;
+	return c->rect;
+}
+
+int dde_set(TWorkArea* context, const char* name,void* pval){
+	(void)context;
+	(void)name;
+	(void)pval;
+	return 1;
+}
+
+void ddear_run_optical_flow(TWorkArea* context, const void* img,int stride,int w,int h,int is_post_dde){
+	(void)context;
+	(void)img;
+	(void)stride;
+	(void)w;
+	(void)h;
+	(void)is_post_dde;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#ifndef STUB_CORE_H
+#define STUB_CORE_H
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/***************************************************************
+Here goes a stand-in for dde_core, to run ddeutil without the
+binary library and v3.bin. The detector reports the faces added
+with `stub_core_add_face` whenever a window of the call could see
+them, and the tracker fits a box of landmarks to the rect it was
+initialized with. Both check the pixel layout they are handed the
+way the real library reads it: 4 bytes per pixel, or 1 for a
+detector with "is_mono" set.
+***************************************************************/
+
+/**
+\brief Add a face for the stub detector to find
+\param x is the left edge, in pixels
+\param y is the top edge, in pixels
+\param size is the width and height, in pixels
+\param rotation_mode is the only rotation mode that finds it, or -1
+       for all of them
+\param detector_type is the only detector type that finds it, or -1
+       for all of them
+*/
+void stub_core_add_face(int x,int y,int size,int rotation_mode,int detector_type);
+/// \brief Remove all faces
+void stub_core_clear_faces();
+/**
+\brief Tell the stub detector where the full image starts, so that it
+       can place a sub-image ddeutil passes it, e.g. a band of rows
+\param img points to the image the faces are on
+\param stride is the distance between two rows, in bytes
+\param bpp is the number of bytes per pixel
+*/
+void stub_core_set_image(const void* img,int stride,int bpp);
+/// \brief Get the number of `dde_facedet_run_ex2` calls so far
+int stub_core_detector_calls();
+/// \brief Get the number of calls rejected for a pixel layout mismatch
+int stub_core_layout_errors();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -18,6 +18,8 @@
 // standard C/C++ header boilerplate
 #if defined(_WIN32)&&!defined(USE_STATIC_LIB_WIN)
 #define EXPORT __declspec(dllimport)
+#elif defined(__GNUC__)
+#define EXPORT __attribute__((visibility("default")))
 #else
 #define EXPORT
 #endif
@@ -326,7 +328,7 @@ On x86 / x64 platforms, the v3.bin content and the TWorkArea type
 *must* be aligned to 16-byte boundaries. The ALIGNED_TYPE is
 declared to remind compilers of that.
 */
-#if defined(_M_X86)||defined(_M_IX86)||defined(__i386__)
+#if defined(_M_X86)||defined(_M_IX86)||defined(__i386__)||defined(_M_X64)||defined(__x86_64__)
 #include <emmintrin.h>
 typedef __m128 ALIGNED_TYPE;
 #else
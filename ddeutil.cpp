@@ -0,0 +1,2286 @@
+#include "ddeutil.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_M_IX86)||defined(_M_X64)||defined(__i386__)||defined(__x86_64__)
+#define DDEUTIL_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define DDEUTIL_TARGET(isa)
+#else
+#define DDEUTIL_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////
+// v3.bin mapping
+
+static const void* map_file_readonly(const char* path){
+#ifdef _WIN32
+	HANDLE hfile=CreateFileA(path,GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+	if(hfile==INVALID_HANDLE_VALUE) return NULL;
+	HANDLE hmap=CreateFileMappingA(hfile,NULL,PAGE_READONLY,0,0,NULL);
+	CloseHandle(hfile);
+	if(!hmap) return NULL;
+	// the view keeps the mapping object alive after the handle is closed
+	const void* p=MapViewOfFile(hmap,FILE_MAP_READ,0,0,0);
+	CloseHandle(hmap);
+	return p;
+#else
+	int fd=open(path,O_RDONLY);
+	if(fd<0) return NULL;
+	struct stat st;
+	if(fstat(fd,&st)!=0||st.st_size<=0){
+		close(fd);
+		return NULL;
+	}
+	void* p=mmap(NULL,(size_t)st.st_size,PROT_READ,MAP_SHARED,fd,0);
+	close(fd);
+	if(p==MAP_FAILED) return NULL;
+	return p;
+#endif
+}
+
+int ddeutil_setup_from_file(const char* path, const void* authdata,int authdata_sz){
+	// mappings are page-aligned, which covers the 16-byte requirement of dde_setup
+	const void* p=map_file_readonly(path);
+	if(!p) return -1;
+	return dde_setup(p,authdata,authdata_sz);
+}
+
+/////////////////////////////////////////////////////////////////
+// memory
+
+static ddeutil_alloc_func g_alloc_func=NULL;
+static ddeutil_free_func g_free_func=NULL;
+static void* g_alloc_user=NULL;
+static std::atomic<unsigned int> g_alloc_count(0);
+
+void ddeutil_set_allocator(ddeutil_alloc_func alloc_func,ddeutil_free_func free_func,void* user){
+	if(!alloc_func||!free_func){
+		alloc_func=NULL;
+		free_func=NULL;
+	}
+	g_alloc_func=alloc_func;
+	g_free_func=free_func;
+	g_alloc_user=user;
+}
+
+unsigned int ddeutil_get_alloc_count(){
+	return g_alloc_count.load();
+}
+
+static void* util_alloc(size_t size){
+	g_alloc_count.fetch_add(1);
+	return g_alloc_func?g_alloc_func(size,g_alloc_user):malloc(size);
+}
+
+static void util_free(void* p){
+	if(!p) return;
+	if(g_free_func){
+		g_free_func(p,g_alloc_user);
+	}else{
+		free(p);
+	}
+}
+
+static void* util_calloc(size_t size){
+	void* p=util_alloc(size);
+	if(p) memset(p,0,size);
+	return p;
+}
+
+// Routes the buffers of frames, detectors and sessions to the allocator.
+// It throws std::bad_alloc like std::allocator, so the entry points that
+// grow buffers catch it and return 0 or NULL: nothing unwinds into C code.
+template<class T> struct UtilAllocator{
+	typedef T value_type;
+	UtilAllocator(){}
+	template<class U> UtilAllocator(const UtilAllocator<U>&){}
+	T* allocate(size_t n){
+		T* p=(T*)util_alloc(n*sizeof(T));
+		if(!p) throw std::bad_alloc();
+		return p;
+	}
+	void deallocate(T* p,size_t){
+		util_free(p);
+	}
+};
+template<class T,class U> bool operator==(const UtilAllocator<T>&,const UtilAllocator<U>&){return true;}
+template<class T,class U> bool operator!=(const UtilAllocator<T>&,const UtilAllocator<U>&){return false;}
+
+template<class T> struct Buffer{
+	typedef std::vector<T,UtilAllocator<T> > type;
+};
+
+template<class T> static T* util_new(){
+	void* p=util_alloc(sizeof(T));
+	return p?new(p) T():NULL;
+}
+
+template<class T,class A> static T* util_new(A a){
+	void* p=util_alloc(sizeof(T));
+	if(!p) return NULL;
+	try{
+		return new(p) T(a);
+	}catch(...){
+		util_free(p);
+		throw;
+	}
+}
+
+template<class T> static void util_delete(T* p){
+	if(!p) return;
+	p->~T();
+	util_free(p);
+}
+
+#define CACHE_LINE 64
+
+// The distance between two contexts in a slab: whole cache lines, so that
+// faces tracked on different threads never share a line
+static size_t context_stride(){
+	return (dde_context_size()+CACHE_LINE-1)&~(size_t)(CACHE_LINE-1);
+}
+
+// A stable sort that doesn't allocate, for the short arrays of a call
+template<class T,class Less> static void insertion_sort(T* a,int n,Less less){
+	for(int i=1;i<n;i++){
+		for(int j=i;j>0&&less(a[j],a[j-1]);j--) std::swap(a[j],a[j-1]);
+	}
+}
+
+/////////////////////////////////////////////////////////////////
+// dde_core serialization
+
+static std::atomic<int> g_core_serialized(1);
+static std::mutex g_core_mutex;
+
+// Holds the process-wide dde_core lock for its scope when serialization is enabled
+class CoreLock{
+public:
+	CoreLock():m_locked(g_core_serialized.load()!=0){
+		if(m_locked) g_core_mutex.lock();
+	}
+	~CoreLock(){
+		if(m_locked) g_core_mutex.unlock();
+	}
+private:
+	CoreLock(const CoreLock&);
+	CoreLock& operator=(const CoreLock&);
+	bool m_locked;
+};
+
+int ddeutil_set_core_serialization(int enable){
+	return g_core_serialized.exchange(enable?1:0);
+}
+
+/////////////////////////////////////////////////////////////////
+// pixel kernels
+
+enum{
+	ISA_SCALAR,
+	ISA_SSSE3,
+	ISA_AVX2,
+};
+
+static int detect_isa(){
+#if defined(DDEUTIL_X86)&&defined(_MSC_VER)
+	int regs[4];
+	__cpuid(regs,1);
+	int ssse3=regs[2]&(1<<9);
+	// AVX2 also needs the OS to save the YMM registers
+	if((regs[2]&(1<<27))&&(regs[2]&(1<<28))&&(_xgetbv(0)&6)==6){
+		__cpuidex(regs,7,0);
+		if(regs[1]&(1<<5)) return ISA_AVX2;
+	}
+	return ssse3?ISA_SSSE3:ISA_SCALAR;
+#elif defined(DDEUTIL_X86)
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")) return ISA_AVX2;
+	if(__builtin_cpu_supports("ssse3")) return ISA_SSSE3;
+	return ISA_SCALAR;
+#else
+	return ISA_SCALAR;
+#endif
+}
+
+static const int g_isa=detect_isa();
+
+// Luminance of packed 24-bit pixels. The weights are symmetric in the
+// first and the third channel, so the same code serves BGR and RGB.
+static void gray_row_c3_scalar(unsigned char* dst,const unsigned char* src,int n){
+	for(int x=0;x<n;x++) dst[x]=(unsigned char)((src[x*3]+2*src[x*3+1]+src[x*3+2]+2)>>2);
+}
+
+#ifdef DDEUTIL_X86
+// pshufb masks gathering channel c of 16 packed pixels from the 3 blocks of 16 bytes they span
+#define Z -128
+static const signed char g_c3_masks[3][3][16]={
+	{{0,3,6,9,12,15,Z,Z,Z,Z,Z,Z,Z,Z,Z,Z},{Z,Z,Z,Z,Z,Z,2,5,8,11,14,Z,Z,Z,Z,Z},{Z,Z,Z,Z,Z,Z,Z,Z,Z,Z,Z,1,4,7,10,13}},
+	{{1,4,7,10,13,Z,Z,Z,Z,Z,Z,Z,Z,Z,Z,Z},{Z,Z,Z,Z,Z,0,3,6,9,12,15,Z,Z,Z,Z,Z},{Z,Z,Z,Z,Z,Z,Z,Z,Z,Z,Z,2,5,8,11,14}},
+	{{2,5,8,11,14,Z,Z,Z,Z,Z,Z,Z,Z,Z,Z,Z},{Z,Z,Z,Z,Z,1,4,7,10,13,Z,Z,Z,Z,Z,Z},{Z,Z,Z,Z,Z,Z,Z,Z,Z,Z,0,3,6,9,12,15}},
+};
+#undef Z
+
+DDEUTIL_TARGET("ssse3")
+static __m128i gather_c3_ssse3(__m128i a,__m128i b,__m128i c,int ch){
+	__m128i r=_mm_shuffle_epi8(a,_mm_loadu_si128((const __m128i*)g_c3_masks[ch][0]));
+	r=_mm_or_si128(r,_mm_shuffle_epi8(b,_mm_loadu_si128((const __m128i*)g_c3_masks[ch][1])));
+	return _mm_or_si128(r,_mm_shuffle_epi8(c,_mm_loadu_si128((const __m128i*)g_c3_masks[ch][2])));
+}
+
+DDEUTIL_TARGET("ssse3")
+static __m128i gray_epi16_ssse3(__m128i c0,__m128i c1,__m128i c2){
+	__m128i sum=_mm_add_epi16(_mm_add_epi16(c0,c2),_mm_add_epi16(c1,c1));
+	return _mm_srli_epi16(_mm_add_epi16(sum,_mm_set1_epi16(2)),2);
+}
+
+DDEUTIL_TARGET("ssse3")
+static void gray_row_c3_ssse3(unsigned char* dst,const unsigned char* src,int n){
+	__m128i zero=_mm_setzero_si128();
+	int x=0;
+	for(;x+16<=n;x+=16){
+		const unsigned char* p=src+x*3;
+		__m128i a=_mm_loadu_si128((const __m128i*)p);
+		__m128i b=_mm_loadu_si128((const __m128i*)(p+16));
+		__m128i c=_mm_loadu_si128((const __m128i*)(p+32));
+		__m128i c0=gather_c3_ssse3(a,b,c,0);
+		__m128i c1=gather_c3_ssse3(a,b,c,1);
+		__m128i c2=gather_c3_ssse3(a,b,c,2);
+		__m128i lo=gray_epi16_ssse3(_mm_unpacklo_epi8(c0,zero),_mm_unpacklo_epi8(c1,zero),_mm_unpacklo_epi8(c2,zero));
+		__m128i hi=gray_epi16_ssse3(_mm_unpackhi_epi8(c0,zero),_mm_unpackhi_epi8(c1,zero),_mm_unpackhi_epi8(c2,zero));
+		_mm_storeu_si128((__m128i*)(dst+x),_mm_packus_epi16(lo,hi));
+	}
+	gray_row_c3_scalar(dst+x,src+x*3,n-x);
+}
+
+DDEUTIL_TARGET("avx2")
+static __m256i gather_c3_avx2(__m256i a,__m256i b,__m256i c,int ch){
+	__m256i r=_mm256_shuffle_epi8(a,_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)g_c3_masks[ch][0])));
+	r=_mm256_or_si256(r,_mm256_shuffle_epi8(b,_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)g_c3_masks[ch][1]))));
+	return _mm256_or_si256(r,_mm256_shuffle_epi8(c,_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)g_c3_masks[ch][2]))));
+}
+
+DDEUTIL_TARGET("avx2")
+static __m256i gray_epi16_avx2(__m256i c0,__m256i c1,__m256i c2){
+	__m256i sum=_mm256_add_epi16(_mm256_add_epi16(c0,c2),_mm256_add_epi16(c1,c1));
+	return _mm256_srli_epi16(_mm256_add_epi16(sum,_mm256_set1_epi16(2)),2);
+}
+
+DDEUTIL_TARGET("avx2")
+static __m256i load2_avx2(const unsigned char* lo,const unsigned char* hi){
+	__m256i r=_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)lo));
+	return _mm256_inserti128_si256(r,_mm_loadu_si128((const __m128i*)hi),1);
+}
+
+DDEUTIL_TARGET("avx2")
+static void gray_row_c3_avx2(unsigned char* dst,const unsigned char* src,int n){
+	__m256i zero=_mm256_setzero_si256();
+	int x=0;
+	// each 128-bit lane handles 16 pixels, the same way as the SSSE3 kernel
+	for(;x+32<=n;x+=32){
+		const unsigned char* p=src+x*3;
+		__m256i a=load2_avx2(p,p+48);
+		__m256i b=load2_avx2(p+16,p+64);
+		__m256i c=load2_avx2(p+32,p+80);
+		__m256i c0=gather_c3_avx2(a,b,c,0);
+		__m256i c1=gather_c3_avx2(a,b,c,1);
+		__m256i c2=gather_c3_avx2(a,b,c,2);
+		__m256i lo=gray_epi16_avx2(_mm256_unpacklo_epi8(c0,zero),_mm256_unpacklo_epi8(c1,zero),_mm256_unpacklo_epi8(c2,zero));
+		__m256i hi=gray_epi16_avx2(_mm256_unpackhi_epi8(c0,zero),_mm256_unpackhi_epi8(c1,zero),_mm256_unpackhi_epi8(c2,zero));
+		_mm256_storeu_si256((__m256i*)(dst+x),_mm256_packus_epi16(lo,hi));
+	}
+	gray_row_c3_ssse3(dst+x,src+x*3,n-x);
+}
+
+// Returns the number of pixels done, the rest is left to the caller
+DDEUTIL_TARGET("ssse3")
+static int expand_row_c3_ssse3(unsigned char* dst,const unsigned char* src,int n){
+	__m128i mask=_mm_setr_epi8(0,1,2,-128,3,4,5,-128,6,7,8,-128,9,10,11,-128);
+	__m128i alpha=_mm_set1_epi32((int)0xff000000);
+	int x=0;
+	// each step reads 16 bytes for 4 pixels, stay clear of the row end
+	for(;x+6<=n;x+=4){
+		__m128i v=_mm_loadu_si128((const __m128i*)(src+x*3));
+		_mm_storeu_si128((__m128i*)(dst+x*4),_mm_or_si128(_mm_shuffle_epi8(v,mask),alpha));
+	}
+	return x;
+}
+#endif
+
+static void gray_row_c3(unsigned char* dst,const unsigned char* src,int n){
+#ifdef DDEUTIL_X86
+	if(g_isa>=ISA_AVX2){
+		gray_row_c3_avx2(dst,src,n);
+		return;
+	}
+	if(g_isa>=ISA_SSSE3){
+		gray_row_c3_ssse3(dst,src,n);
+		return;
+	}
+#endif
+	gray_row_c3_scalar(dst,src,n);
+}
+
+// Luminance of 32-bit pixels. RGBA and BGRA share a flag, so R and B get
+// the same weight, as in gray_row_c3.
+static void gray_row_c4_scalar(unsigned char* dst,const unsigned char* src,int n){
+	for(int x=0;x<n;x++) dst[x]=(unsigned char)((src[x*4]+2*src[x*4+1]+src[x*4+2]+2)>>2);
+}
+
+// Halves a pair of rows with a 2x2 box filter, n is the number of output pixels
+static void downsample_row_scalar(unsigned char* dst,const unsigned char* s0,const unsigned char* s1,int n){
+	for(int x=0;x<n;x++) dst[x]=(unsigned char)((s0[2*x]+s0[2*x+1]+s1[2*x]+s1[2*x+1]+2)>>2);
+}
+
+#ifdef DDEUTIL_X86
+DDEUTIL_TARGET("ssse3")
+static void gray_row_c4_ssse3(unsigned char* dst,const unsigned char* src,int n){
+	// per pixel, madd yields r+2g and b, hadd adds them up
+	__m128i weights=_mm_setr_epi8(1,2,1,0,1,2,1,0,1,2,1,0,1,2,1,0);
+	__m128i round=_mm_set1_epi16(2);
+	int x=0;
+	for(;x+16<=n;x+=16){
+		const __m128i* p=(const __m128i*)(src+x*4);
+		__m128i a=_mm_maddubs_epi16(_mm_loadu_si128(p),weights);
+		__m128i b=_mm_maddubs_epi16(_mm_loadu_si128(p+1),weights);
+		__m128i c=_mm_maddubs_epi16(_mm_loadu_si128(p+2),weights);
+		__m128i d=_mm_maddubs_epi16(_mm_loadu_si128(p+3),weights);
+		__m128i lo=_mm_srli_epi16(_mm_add_epi16(_mm_hadd_epi16(a,b),round),2);
+		__m128i hi=_mm_srli_epi16(_mm_add_epi16(_mm_hadd_epi16(c,d),round),2);
+		_mm_storeu_si128((__m128i*)(dst+x),_mm_packus_epi16(lo,hi));
+	}
+	gray_row_c4_scalar(dst+x,src+x*4,n-x);
+}
+
+DDEUTIL_TARGET("avx2")
+static void gray_row_c4_avx2(unsigned char* dst,const unsigned char* src,int n){
+	__m256i weights=_mm256_broadcastsi128_si256(_mm_setr_epi8(1,2,1,0,1,2,1,0,1,2,1,0,1,2,1,0));
+	__m256i round=_mm256_set1_epi16(2);
+	// hadd and packus work within 128-bit lanes, this puts the groups of 4 pixels back in order
+	__m256i order=_mm256_setr_epi32(0,4,1,5,2,6,3,7);
+	int x=0;
+	for(;x+32<=n;x+=32){
+		const __m256i* p=(const __m256i*)(src+x*4);
+		__m256i a=_mm256_maddubs_epi16(_mm256_loadu_si256(p),weights);
+		__m256i b=_mm256_maddubs_epi16(_mm256_loadu_si256(p+1),weights);
+		__m256i c=_mm256_maddubs_epi16(_mm256_loadu_si256(p+2),weights);
+		__m256i d=_mm256_maddubs_epi16(_mm256_loadu_si256(p+3),weights);
+		__m256i lo=_mm256_srli_epi16(_mm256_add_epi16(_mm256_hadd_epi16(a,b),round),2);
+		__m256i hi=_mm256_srli_epi16(_mm256_add_epi16(_mm256_hadd_epi16(c,d),round),2);
+		_mm256_storeu_si256((__m256i*)(dst+x),_mm256_permutevar8x32_epi32(_mm256_packus_epi16(lo,hi),order));
+	}
+	gray_row_c4_ssse3(dst+x,src+x*4,n-x);
+}
+
+DDEUTIL_TARGET("ssse3")
+static void downsample_row_ssse3(unsigned char* dst,const unsigned char* s0,const unsigned char* s1,int n){
+	__m128i ones=_mm_set1_epi8(1);
+	__m128i round=_mm_set1_epi16(2);
+	int x=0;
+	for(;x+16<=n;x+=16){
+		__m128i lo=_mm_add_epi16(_mm_maddubs_epi16(_mm_loadu_si128((const __m128i*)(s0+2*x)),ones),
+			_mm_maddubs_epi16(_mm_loadu_si128((const __m128i*)(s1+2*x)),ones));
+		__m128i hi=_mm_add_epi16(_mm_maddubs_epi16(_mm_loadu_si128((const __m128i*)(s0+2*x+16)),ones),
+			_mm_maddubs_epi16(_mm_loadu_si128((const __m128i*)(s1+2*x+16)),ones));
+		lo=_mm_srli_epi16(_mm_add_epi16(lo,round),2);
+		hi=_mm_srli_epi16(_mm_add_epi16(hi,round),2);
+		_mm_storeu_si128((__m128i*)(dst+x),_mm_packus_epi16(lo,hi));
+	}
+	downsample_row_scalar(dst+x,s0+2*x,s1+2*x,n-x);
+}
+
+DDEUTIL_TARGET("avx2")
+static void downsample_row_avx2(unsigned char* dst,const unsigned char* s0,const unsigned char* s1,int n){
+	__m256i ones=_mm256_set1_epi8(1);
+	__m256i round=_mm256_set1_epi16(2);
+	int x=0;
+	for(;x+32<=n;x+=32){
+		__m256i lo=_mm256_add_epi16(_mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i*)(s0+2*x)),ones),
+			_mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i*)(s1+2*x)),ones));
+		__m256i hi=_mm256_add_epi16(_mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i*)(s0+2*x+32)),ones),
+			_mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i*)(s1+2*x+32)),ones));
+		lo=_mm256_srli_epi16(_mm256_add_epi16(lo,round),2);
+		hi=_mm256_srli_epi16(_mm256_add_epi16(hi,round),2);
+		// packus works within 128-bit lanes, swap the middle quarters back
+		_mm256_storeu_si256((__m256i*)(dst+x),_mm256_permute4x64_epi64(_mm256_packus_epi16(lo,hi),0xd8));
+	}
+	downsample_row_ssse3(dst+x,s0+2*x,s1+2*x,n-x);
+}
+#endif
+
+static void gray_row_c4(unsigned char* dst,const unsigned char* src,int n){
+#ifdef DDEUTIL_X86
+	if(g_isa>=ISA_AVX2){
+		gray_row_c4_avx2(dst,src,n);
+		return;
+	}
+	if(g_isa>=ISA_SSSE3){
+		gray_row_c4_ssse3(dst,src,n);
+		return;
+	}
+#endif
+	gray_row_c4_scalar(dst,src,n);
+}
+
+static void downsample_row(unsigned char* dst,const unsigned char* s0,const unsigned char* s1,int n){
+#ifdef DDEUTIL_X86
+	if(g_isa>=ISA_AVX2){
+		downsample_row_avx2(dst,s0,s1,n);
+		return;
+	}
+	if(g_isa>=ISA_SSSE3){
+		downsample_row_ssse3(dst,s0,s1,n);
+		return;
+	}
+#endif
+	downsample_row_scalar(dst,s0,s1,n);
+}
+
+// Expands packed 24-bit pixels to 32 bits with an opaque alpha, keeping the channel order
+static void expand_row_c3_scalar(unsigned char* dst,const unsigned char* src,int n){
+	for(int x=0;x<n;x++){
+		dst[x*4+0]=src[x*3+0];
+		dst[x*4+1]=src[x*3+1];
+		dst[x*4+2]=src[x*3+2];
+		dst[x*4+3]=0xff;
+	}
+}
+
+static void expand_row_c3(unsigned char* dst,const unsigned char* src,int n){
+	int x=0;
+#ifdef DDEUTIL_X86
+	if(g_isa>=ISA_SSSE3) x=expand_row_c3_ssse3(dst,src,n);
+#endif
+	expand_row_c3_scalar(dst+x*4,src+x*3,n-x);
+}
+
+static void expand_row_c1(unsigned char* dst,const unsigned char* src,int n){
+	for(int x=0;x<n;x++){
+		dst[x*4+0]=src[x];
+		dst[x*4+1]=src[x];
+		dst[x*4+2]=src[x];
+		dst[x*4+3]=0xff;
+	}
+}
+
+/////////////////////////////////////////////////////////////////
+// frames
+
+#define FRAME_MAX_LEVELS 8
+// pyramid levels stop once either side would drop below this
+#define FRAME_MIN_LEVEL_SIZE 16
+
+struct ddeutil_frame{
+	const unsigned char* img;
+	int stride,w,h,flags;
+	// bitmask of the pyramid levels built for the current image
+	unsigned int levels_built;
+	const unsigned char* gray[FRAME_MAX_LEVELS];
+	int gray_w[FRAME_MAX_LEVELS],gray_h[FRAME_MAX_LEVELS],gray_stride[FRAME_MAX_LEVELS];
+	Buffer<unsigned char>::type gray_storage[FRAME_MAX_LEVELS];
+	// 32-bit copy of a 24-bit or gray image, hldde_next only takes 32-bit pixels
+	int core_built;
+	Buffer<unsigned char>::type core_storage;
+};
+
+ddeutil_frame* ddeutil_frame_create(const void* img,int stride,int w,int h,int flags){
+	ddeutil_frame* f=util_new<ddeutil_frame>();
+	if(!f) return NULL;
+	ddeutil_frame_set(f,img,stride,w,h,flags);
+	return f;
+}
+
+void ddeutil_frame_destroy(ddeutil_frame* f){
+	util_delete(f);
+}
+
+void ddeutil_frame_set(ddeutil_frame* f,const void* img,int stride,int w,int h,int flags){
+	f->img=(const unsigned char*)img;
+	f->stride=stride;
+	f->w=w;
+	f->h=h;
+	f->flags=flags;
+	// the level buffers are kept, they are reused by the next image of the same size
+	f->levels_built=0;
+	f->core_built=0;
+}
+
+// Converts the frame image to 8-bit luminance
+static void frame_build_gray(ddeutil_frame* f){
+	int format=f->flags&FLAG_IMAGE_FORMAT_MASK;
+	if(format==FLAG_IMAGE_FORMAT_GRAYSCALE){
+		f->gray[0]=f->img;
+		f->gray_stride[0]=f->stride;
+	}else{
+		Buffer<unsigned char>::type& buf=f->gray_storage[0];
+		buf.resize((size_t)f->w*(size_t)f->h);
+		for(int y=0;y<f->h;y++){
+			const unsigned char* src=f->img+(size_t)y*(size_t)f->stride;
+			unsigned char* dst=&buf[(size_t)y*(size_t)f->w];
+			if(format==DDEUTIL_FLAG_IMAGE_FORMAT_BGR||format==DDEUTIL_FLAG_IMAGE_FORMAT_RGB){
+				gray_row_c3(dst,src,f->w);
+			}else{
+				gray_row_c4(dst,src,f->w);
+			}
+		}
+		f->gray[0]=&buf[0];
+		f->gray_stride[0]=f->w;
+	}
+	f->gray_w[0]=f->w;
+	f->gray_h[0]=f->h;
+}
+
+// Halves the previous pyramid level with a 2x2 box filter
+static void frame_build_level(ddeutil_frame* f,int level){
+	int w=f->gray_w[level-1]>>1,h=f->gray_h[level-1]>>1;
+	const unsigned char* src=f->gray[level-1];
+	int src_stride=f->gray_stride[level-1];
+	Buffer<unsigned char>::type& buf=f->gray_storage[level];
+	buf.resize((size_t)w*(size_t)h);
+	for(int y=0;y<h;y++){
+		const unsigned char* s0=src+(size_t)(2*y)*(size_t)src_stride;
+		const unsigned char* s1=s0+src_stride;
+		unsigned char* dst=&buf[(size_t)y*(size_t)w];
+		downsample_row(dst,s0,s1,w);
+	}
+	f->gray[level]=&buf[0];
+	f->gray_w[level]=w;
+	f->gray_h[level]=h;
+	f->gray_stride[level]=w;
+}
+
+const unsigned char* ddeutil_frame_get_gray(ddeutil_frame* f,int level,int* pw,int* ph,int* pstride){
+	if(level<0||level>=FRAME_MAX_LEVELS) return NULL;
+	if(level>0&&((f->w>>level)<FRAME_MIN_LEVEL_SIZE||(f->h>>level)<FRAME_MIN_LEVEL_SIZE)) return NULL;
+	try{
+		for(int i=0;i<=level;i++){
+			if(f->levels_built&(1u<<i)) continue;
+			if(i==0){
+				frame_build_gray(f);
+			}else{
+				frame_build_level(f,i);
+			}
+			f->levels_built|=1u<<i;
+		}
+	}catch(...){
+		return NULL;
+	}
+	if(pw) *pw=f->gray_w[level];
+	if(ph) *ph=f->gray_h[level];
+	if(pstride) *pstride=f->gray_stride[level];
+	return f->gray[level];
+}
+
+// Returns the image in the layout the tracker expects, 32-bit pixels.
+// Throws std::bad_alloc when the 32-bit copy can't be allocated.
+static const void* frame_core_image(ddeutil_frame* f,int* pstride){
+	int format=f->flags&FLAG_IMAGE_FORMAT_MASK;
+	if(format!=DDEUTIL_FLAG_IMAGE_FORMAT_BGR&&format!=DDEUTIL_FLAG_IMAGE_FORMAT_RGB&&format!=FLAG_IMAGE_FORMAT_GRAYSCALE){
+		*pstride=f->stride;
+		return f->img;
+	}
+	if(!f->core_built){
+		f->core_storage.resize((size_t)f->w*(size_t)f->h*4);
+		for(int y=0;y<f->h;y++){
+			unsigned char* dst=&f->core_storage[(size_t)y*(size_t)f->w*4];
+			const unsigned char* src=f->img+(size_t)y*(size_t)f->stride;
+			if(format==FLAG_IMAGE_FORMAT_GRAYSCALE){
+				expand_row_c1(dst,src,f->w);
+			}else{
+				expand_row_c3(dst,src,f->w);
+			}
+		}
+		f->core_built=1;
+	}
+	*pstride=f->w*4;
+	return &f->core_storage[0];
+}
+
+// Returns the image in the layout the detector expects: gray images go as
+// they are with "is_mono" set, anything else as 32-bit pixels
+static const void* frame_detector_image(ddeutil_frame* f,int* pstride,float* pis_mono){
+	if((f->flags&FLAG_IMAGE_FORMAT_MASK)==FLAG_IMAGE_FORMAT_GRAYSCALE){
+		*pstride=f->stride;
+		*pis_mono=1.f;
+		return f->img;
+	}
+	*pis_mono=0.f;
+	return frame_core_image(f,pstride);
+}
+
+int ddeutil_facedet_run_frame(void* detector,ddeutil_frame* f,int* ret,int max_faces,int rotation_mode,int detector_type){
+	int stride=0;
+	float is_mono=0.f;
+	const void* img=NULL;
+	try{
+		img=frame_detector_image(f,&stride,&is_mono);
+	}catch(...){
+		return 0;
+	}
+	CoreLock lock;
+	dde_facedet_set(detector,"is_mono",&is_mono);
+	return dde_facedet_run_ex2(detector,img,stride,f->w,f->h,ret,max_faces,rotation_mode,detector_type);
+}
+
+int ddeutil_track_frame(TWorkArea* context,ddeutil_frame* f){
+	int stride=0;
+	const void* img=NULL;
+	try{
+		img=frame_core_image(f,&stride);
+	}catch(...){
+		return 0;
+	}
+	CoreLock lock;
+	return hldde_next(context,(void*)img,stride,f->w,f->h);
+}
+
+/////////////////////////////////////////////////////////////////
+// region-of-interest tracking
+
+// Computes the bounding box x0,y0,x1,y1 of the landmarks in a context,
+// the caller holds the core lock
+static int context_landmark_bounds(TWorkArea* ctx,float* box){
+	int dim=0;
+	float* lm=dde_get(ctx,"landmarks",&dim);
+	if(!lm||dim<2) return 0;
+	box[0]=box[2]=lm[0];
+	box[1]=box[3]=lm[1];
+	for(int j=2;j+1<dim;j+=2){
+		if(lm[j]<box[0]) box[0]=lm[j];
+		if(lm[j]>box[2]) box[2]=lm[j];
+		if(lm[j+1]<box[1]) box[1]=lm[j+1];
+		if(lm[j+1]>box[3]) box[3]=lm[j+1];
+	}
+	return 1;
+}
+
+int ddeutil_get_roi(TWorkArea* context,float margin,int w,int h,int* roi){
+	float box[4];
+	{
+		CoreLock lock;
+		if(!context_landmark_bounds(context,box)) return 0;
+	}
+	float mx=(box[2]-box[0])*margin,my=(box[3]-box[1])*margin;
+	int x0=(int)(box[0]-mx),y0=(int)(box[1]-my);
+	int x1=(int)(box[2]+mx)+1,y1=(int)(box[3]+my)+1;
+	if(x0<0) x0=0;
+	if(y0<0) y0=0;
+	if(x1>w) x1=w;
+	if(y1>h) y1=h;
+	if(x1<=x0||y1<=y0) return 0;
+	roi[0]=x0;
+	roi[1]=y0;
+	roi[2]=x1-x0;
+	roi[3]=y1-y0;
+	return 1;
+}
+
+// the value of the canvas pixels outside the window
+#define CANVAS_BACKGROUND 0x80
+
+// A full-frame 32-bit canvas per thread, only the ROI is written on each
+// call. It can outlive every ddeutil object, so it keeps the free function
+// it was allocated with: the thread may exit after the allocator changed.
+struct RoiCanvas{
+	unsigned char* pixels;
+	ddeutil_free_func free_func;
+	void* free_user;
+	// the image size the canvas was laid out for, a 480x640 canvas is no 640x480 one
+	int w,h;
+	// the window the last call on this thread wrote
+	int roi[4];
+	~RoiCanvas(){
+		release();
+	}
+	void release(){
+		if(pixels){
+			if(free_func){
+				free_func(pixels,free_user);
+			}else{
+				free(pixels);
+			}
+		}
+		pixels=NULL;
+		w=0;
+		h=0;
+		memset(roi,0,sizeof(roi));
+	}
+};
+
+static thread_local RoiCanvas g_canvas={NULL,NULL,NULL,0,0,{0,0,0,0}};
+
+int ddeutil_track_roi(TWorkArea* context,const void* roi_img,int roi_stride,const int* roi,int w,int h,int flags){
+	int format=flags&FLAG_IMAGE_FORMAT_MASK;
+	size_t canvas_size=(size_t)w*(size_t)h*4;
+	int x0=roi[0],y0=roi[1],rw=roi[2],rh=roi[3];
+	if(x0<0||y0<0||rw<=0||rh<=0||x0+rw>w||y0+rh>h) return 0;
+	if(w!=g_canvas.w||h!=g_canvas.h){
+		// the last window is in the old geometry, start over from a blank canvas
+		g_canvas.release();
+		g_canvas.pixels=(unsigned char*)util_alloc(canvas_size);
+		if(!g_canvas.pixels) return 0;
+		g_canvas.free_func=g_free_func;
+		g_canvas.free_user=g_alloc_user;
+		memset(g_canvas.pixels,CANVAS_BACKGROUND,canvas_size);
+		g_canvas.w=w;
+		g_canvas.h=h;
+	}
+	unsigned char* canvas=g_canvas.pixels;
+	int* last=g_canvas.roi;
+	if(memcmp(last,roi,sizeof(g_canvas.roi))!=0){
+		// the last window may hold another face, blank what the new one doesn't cover
+		int px0=last[0],px1=last[0]+last[2];
+		for(int y=last[1];y<last[1]+last[3];y++){
+			unsigned char* row=canvas+(size_t)y*(size_t)w*4;
+			if(y<y0||y>=y0+rh){
+				memset(row+(size_t)px0*4,CANVAS_BACKGROUND,(size_t)(px1-px0)*4);
+				continue;
+			}
+			if(px0<x0) memset(row+(size_t)px0*4,CANVAS_BACKGROUND,(size_t)((px1<x0?px1:x0)-px0)*4);
+			if(px1>x0+rw){
+				int x=px0>x0+rw?px0:x0+rw;
+				memset(row+(size_t)x*4,CANVAS_BACKGROUND,(size_t)(px1-x)*4);
+			}
+		}
+		memcpy(last,roi,sizeof(g_canvas.roi));
+	}
+	for(int y=0;y<rh;y++){
+		const unsigned char* src=(const unsigned char*)roi_img+(size_t)y*(size_t)roi_stride;
+		unsigned char* dst=canvas+((size_t)(y0+y)*(size_t)w+(size_t)x0)*4;
+		if(format==DDEUTIL_FLAG_IMAGE_FORMAT_BGR||format==DDEUTIL_FLAG_IMAGE_FORMAT_RGB){
+			expand_row_c3(dst,src,rw);
+		}else if(format==FLAG_IMAGE_FORMAT_GRAYSCALE){
+			expand_row_c1(dst,src,rw);
+		}else{
+			memcpy(dst,src,(size_t)rw*4);
+		}
+	}
+	CoreLock lock;
+	return hldde_next(context,canvas,w*4,w,h);
+}
+
+void ddeutil_track_roi_release(){
+	g_canvas.release();
+}
+
+/////////////////////////////////////////////////////////////////
+// context snapshots
+
+// thresholds on face_confirmation_failure_stress, as in the guide
+#define STRESS_INVALID 2.f
+#define STRESS_RESET 10.f
+
+#define SNAPSHOT_MAGIC 0x31504e53u
+// a face whose center lies further than this many face sizes away from
+// the snapshot is not worth resuming
+#define SNAPSHOT_MAX_SHIFT 0.5f
+
+struct SnapshotHeader{
+	unsigned int magic;
+	unsigned int size;
+	// the context saved from, the only one the memory may go back to
+	const TWorkArea* context;
+	// the landmark bounds at the time of the snapshot
+	float box[4];
+};
+
+size_t ddeutil_context_snapshot_size(){
+	return sizeof(SnapshotHeader)+dde_context_size();
+}
+
+int ddeutil_context_save(TWorkArea* context,void* buf,size_t size){
+	if(size<ddeutil_context_snapshot_size()) return 0;
+	SnapshotHeader header;
+	header.magic=SNAPSHOT_MAGIC;
+	header.size=(unsigned int)dde_context_size();
+	header.context=context;
+	CoreLock lock;
+	if(!context_landmark_bounds(context,header.box)) return 0;
+	memcpy(buf,&header,sizeof(header));
+	memcpy((unsigned char*)buf+sizeof(header),context,header.size);
+	return 1;
+}
+
+int ddeutil_context_restore(TWorkArea* context,const void* buf,const float* rect,const void* img,int stride,int w,int h,int rotation_mode){
+	SnapshotHeader header;
+	memcpy(&header,buf,sizeof(header));
+	// the context may hold pointers into itself or into the core's data, which
+	// only stay valid in the context and the process the snapshot came from
+	int usable=header.magic==SNAPSHOT_MAGIC&&header.size==(unsigned int)dde_context_size()&&header.context==context;
+	if(usable){
+		// a face that has moved too far would have to converge from scratch anyway
+		float size=header.box[2]-header.box[0];
+		float dx=0.5f*(rect[0]+rect[2]-header.box[0]-header.box[2]);
+		float dy=0.5f*(rect[1]+rect[3]-header.box[1]-header.box[3]);
+		usable=std::sqrt(dx*dx+dy*dy)<=SNAPSHOT_MAX_SHIFT*size;
+	}
+	CoreLock lock;
+	if(usable){
+		memcpy(context,(const unsigned char*)buf+sizeof(header),header.size);
+		// one verification step: the snapshot must still fit the face
+		if(hldde_next(context,(void*)img,stride,w,h)>0){
+			int dim=0;
+			float* stress=dde_get(context,"face_confirmation_failure_stress",&dim);
+			if(!stress||dim<=0||stress[0]<=STRESS_INVALID) return 1;
+		}
+	}
+	dde_init_context_ex(context,rect,w,h,rotation_mode,NULL);
+	return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+// identity cache
+
+#define IDENTITY_CACHE_MAGIC 0x32434449u
+#define IDENTITY_CACHE_MAX_ID 64
+// the file holds the user id and the identity of each entry
+#define IDENTITY_CACHE_ENTRY_SIZE (IDENTITY_CACHE_MAX_ID+N_IDENTITIES*sizeof(float))
+
+struct IdentityEntry{
+	char user_id[IDENTITY_CACHE_MAX_ID];
+	// the cache clock at the last store or warm start, the oldest entry is evicted first
+	unsigned int last_used;
+	float identity[N_IDENTITIES];
+	// a snapshot of the context stored from, kept in memory only; empty for
+	// entries loaded from the file
+	Buffer<unsigned char>::type snapshot;
+};
+
+struct ddeutil_identity_cache{
+	char* path;
+	int max_users;
+	unsigned int clock;
+	Buffer<IdentityEntry>::type entries;
+};
+
+static IdentityEntry* identity_cache_find(ddeutil_identity_cache* c,const char* user_id){
+	for(size_t i=0;i<c->entries.size();i++){
+		if(!strcmp(c->entries[i].user_id,user_id)) return &c->entries[i];
+	}
+	return NULL;
+}
+
+// Reads the cache file, an unreadable or foreign file leaves the cache empty
+static void identity_cache_load(ddeutil_identity_cache* c){
+	FILE* fp=fopen(c->path,"rb");
+	if(!fp) return;
+	unsigned int header[3];
+	if(fread(header,sizeof(header),1,fp)==1&&header[0]==IDENTITY_CACHE_MAGIC&&header[1]==N_IDENTITIES){
+		// the file is oldest first, keep the most recent users
+		unsigned int first=header[2]>(unsigned int)c->max_users?header[2]-(unsigned int)c->max_users:0;
+		if(first&&fseek(fp,(long)(first*IDENTITY_CACHE_ENTRY_SIZE),SEEK_CUR)!=0) first=header[2];
+		for(unsigned int i=first;i<header[2];i++){
+			IdentityEntry entry;
+			if(fread(entry.user_id,sizeof(entry.user_id),1,fp)!=1) break;
+			if(fread(entry.identity,sizeof(entry.identity),1,fp)!=1) break;
+			entry.user_id[IDENTITY_CACHE_MAX_ID-1]=0;
+			entry.last_used=i-first;
+			c->entries.push_back(entry);
+		}
+		c->clock=(unsigned int)c->entries.size();
+	}
+	fclose(fp);
+}
+
+ddeutil_identity_cache* ddeutil_identity_cache_open(const char* path,int max_users){
+	ddeutil_identity_cache* c=util_new<ddeutil_identity_cache>();
+	if(!c) return NULL;
+	c->path=NULL;
+	c->max_users=max_users>1?max_users:1;
+	c->clock=0;
+	if(path){
+		c->path=(char*)util_alloc(strlen(path)+1);
+		if(!c->path){
+			util_delete(c);
+			return NULL;
+		}
+		strcpy(c->path,path);
+		try{
+			identity_cache_load(c);
+		}catch(...){
+			ddeutil_identity_cache_close(c);
+			return NULL;
+		}
+	}
+	return c;
+}
+
+void ddeutil_identity_cache_close(ddeutil_identity_cache* c){
+	if(!c) return;
+	util_free(c->path);
+	util_delete(c);
+}
+
+int ddeutil_identity_cache_save(ddeutil_identity_cache* c){
+	if(!c->path) return 0;
+	Buffer<char>::type tmp_path;
+	Buffer<const IdentityEntry*>::type order;
+	try{
+		tmp_path.resize(strlen(c->path)+5);
+		order.reserve(c->entries.size());
+	}catch(...){
+		return 0;
+	}
+	// oldest first, so that loading restores the eviction order
+	for(size_t i=0;i<c->entries.size();i++) order.push_back(&c->entries[i]);
+	for(size_t i=1;i<order.size();i++){
+		for(size_t j=i;j>0&&order[j]->last_used<order[j-1]->last_used;j--) std::swap(order[j],order[j-1]);
+	}
+	// write a temporary file and move it over, so that a crash never leaves a torn cache
+	sprintf(&tmp_path[0],"%s.tmp",c->path);
+	FILE* fp=fopen(&tmp_path[0],"wb");
+	if(!fp) return 0;
+	// no snapshots: a context copied into another process is not known to work
+	unsigned int header[3]={IDENTITY_CACHE_MAGIC,N_IDENTITIES,(unsigned int)order.size()};
+	int ok=fwrite(header,sizeof(header),1,fp)==1;
+	for(size_t i=0;i<order.size()&&ok;i++){
+		ok=fwrite(order[i]->user_id,sizeof(order[i]->user_id),1,fp)==1&&
+			fwrite(order[i]->identity,sizeof(order[i]->identity),1,fp)==1;
+	}
+	if(fclose(fp)!=0) ok=0;
+	if(ok){
+#ifdef _WIN32
+		ok=MoveFileExA(&tmp_path[0],c->path,MOVEFILE_REPLACE_EXISTING)!=0;
+#else
+		ok=rename(&tmp_path[0],c->path)==0;
+#endif
+	}
+	if(!ok) remove(&tmp_path[0]);
+	return ok;
+}
+
+int ddeutil_identity_cache_store(ddeutil_identity_cache* c,const char* user_id,TWorkArea* context){
+	if(strlen(user_id)>=IDENTITY_CACHE_MAX_ID) return 0;
+	float identity[N_IDENTITIES];
+	{
+		CoreLock lock;
+		int dim=0;
+		float* p=dde_get(context,"identity",&dim);
+		if(!p||dim<N_IDENTITIES) return 0;
+		memcpy(identity,p,sizeof(identity));
+	}
+	IdentityEntry* entry=identity_cache_find(c,user_id);
+	// a returning user's buffer is written over, storing them again doesn't allocate
+	Buffer<unsigned char>::type snapshot;
+	if(entry) snapshot.swap(entry->snapshot);
+	int ok=1;
+	try{
+		snapshot.resize(ddeutil_context_snapshot_size());
+		// room for a new user, so that nothing below allocates
+		if(!entry&&(int)c->entries.size()<c->max_users) c->entries.reserve(c->entries.size()+1);
+	}catch(...){
+		ok=0;
+	}
+	// a failed save writes nothing, the old snapshot stays as it was
+	if(ok) ok=ddeutil_context_save(context,&snapshot[0],snapshot.size());
+	if(!ok){
+		if(entry) entry->snapshot.swap(snapshot);
+		return 0;
+	}
+	if(!entry){
+		if((int)c->entries.size()>=c->max_users){
+			size_t oldest=0;
+			for(size_t i=1;i<c->entries.size();i++){
+				if(c->entries[i].last_used<c->entries[oldest].last_used) oldest=i;
+			}
+			c->entries.erase(c->entries.begin()+oldest);
+		}
+		c->entries.push_back(IdentityEntry());
+		entry=&c->entries.back();
+		strcpy(entry->user_id,user_id);
+	}
+	entry->snapshot.swap(snapshot);
+	memcpy(entry->identity,identity,sizeof(identity));
+	entry->last_used=c->clock++;
+	return 1;
+}
+
+int ddeutil_identity_cache_get_identity(ddeutil_identity_cache* c,const char* user_id,float* identity){
+	IdentityEntry* entry=identity_cache_find(c,user_id);
+	if(!entry) return 0;
+	memcpy(identity,entry->identity,sizeof(entry->identity));
+	return 1;
+}
+
+int ddeutil_identity_cache_warm_start(ddeutil_identity_cache* c,const char* user_id,TWorkArea* context,const float* rect,const void* img,int stride,int w,int h,int rotation_mode){
+	IdentityEntry* entry=identity_cache_find(c,user_id);
+	if(entry) entry->last_used=c->clock++;
+	if(!entry||entry->snapshot.empty()){
+		CoreLock lock;
+		dde_init_context_ex(context,rect,w,h,rotation_mode,NULL);
+		return 0;
+	}
+	return ddeutil_context_restore(context,&entry->snapshot[0],rect,img,stride,w,h,rotation_mode);
+}
+
+/////////////////////////////////////////////////////////////////
+// worker pool
+
+// A fixed set of threads that run the tasks of one job at a time. Tasks
+// are claimed from a shared counter, so a thread that finishes early
+// keeps taking work from the slower ones. The calling thread works too.
+class WorkerPool{
+public:
+	// worker is the index of the running thread, 0 for the caller, below size()
+	typedef void (*TaskFunc)(void* arg,int task,int worker);
+	explicit WorkerPool(int n_threads):m_func(NULL),m_arg(NULL),m_n_tasks(0),m_next(0),
+	m_generation(0),m_n_finished(0),m_quit(false){
+		// reserved, so that a started thread always makes it into the vector
+		m_threads.reserve(n_threads>1?n_threads-1:0);
+		try{
+			for(int i=1;i<n_threads;i++) m_threads.push_back(std::thread(&WorkerPool::worker_main,this,i));
+		}catch(...){
+			stop();
+			throw;
+		}
+	}
+	~WorkerPool(){
+		stop();
+	}
+	int size()const{
+		return (int)m_threads.size()+1;
+	}
+	void run(TaskFunc func,void* arg,int n_tasks){
+		if(m_threads.empty()||n_tasks<=1){
+			for(int i=0;i<n_tasks;i++) func(arg,i,0);
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_func=func;
+			m_arg=arg;
+			m_n_tasks=n_tasks;
+			m_next.store(0);
+			m_n_finished=0;
+			m_generation++;
+		}
+		m_cv_start.notify_all();
+		work(0);
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while(m_n_finished<(int)m_threads.size()) m_cv_done.wait(lock);
+	}
+private:
+	WorkerPool(const WorkerPool&);
+	WorkerPool& operator=(const WorkerPool&);
+	void stop(){
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_quit=true;
+		}
+		m_cv_start.notify_all();
+		for(size_t i=0;i<m_threads.size();i++) m_threads[i].join();
+	}
+	void work(int worker){
+		for(;;){
+			int task=m_next.fetch_add(1);
+			if(task>=m_n_tasks) break;
+			m_func(m_arg,task,worker);
+		}
+	}
+	void worker_main(int worker){
+		unsigned int generation=0;
+		for(;;){
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				while(!m_quit&&m_generation==generation) m_cv_start.wait(lock);
+				if(m_quit) return;
+				generation=m_generation;
+			}
+			work(worker);
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_n_finished++;
+			}
+			m_cv_done.notify_one();
+		}
+	}
+	Buffer<std::thread>::type m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_cv_start,m_cv_done;
+	TaskFunc m_func;
+	void* m_arg;
+	int m_n_tasks;
+	std::atomic<int> m_next;
+	unsigned int m_generation;
+	int m_n_finished;
+	bool m_quit;
+};
+
+/////////////////////////////////////////////////////////////////
+// batched tracking
+
+static std::mutex g_batch_mutex;
+static WorkerPool* g_batch_pool=NULL;
+
+int ddeutil_set_batch_threads(int n_threads){
+	std::lock_guard<std::mutex> lock(g_batch_mutex);
+	int prev=g_batch_pool?g_batch_pool->size():1;
+	if(n_threads<1) n_threads=1;
+	if(n_threads!=prev){
+		util_delete(g_batch_pool);
+		g_batch_pool=NULL;
+		try{
+			if(n_threads>1) g_batch_pool=util_new<WorkerPool>(n_threads);
+		}catch(...){
+			// no threads to be had, batches run on the caller
+		}
+	}
+	return prev;
+}
+
+struct BatchJob{
+	TWorkArea** contexts;
+	int* results;
+	const void* img;
+	int stride,w,h;
+};
+
+static void batch_job_task(void* arg,int task,int){
+	BatchJob* job=(BatchJob*)arg;
+	CoreLock lock;
+	job->results[task]=hldde_next(job->contexts[task],(void*)job->img,job->stride,job->w,job->h);
+}
+
+int ddeutil_track_batch(TWorkArea** contexts,int n,const void* img,int stride,int w,int h,int* results){
+	BatchJob job={contexts,results,img,stride,w,h};
+	{
+		// a concurrent batch keeps the pool busy, run this one on the calling thread instead
+		std::unique_lock<std::mutex> lock(g_batch_mutex,std::try_to_lock);
+		if(lock.owns_lock()&&g_batch_pool){
+			g_batch_pool->run(batch_job_task,&job,n);
+		}else{
+			for(int i=0;i<n;i++) batch_job_task(&job,i,0);
+		}
+	}
+	int n_tracked=0;
+	for(int i=0;i<n;i++){
+		if(results[i]>0) n_tracked++;
+	}
+	return n_tracked;
+}
+
+/////////////////////////////////////////////////////////////////
+// parallel face detector
+
+#define DETECTOR_MAX_PARAMS 16
+#define DETECTOR_MAX_THREADS 32
+// by default, rects whose intersection over union exceeds this are the same face
+#define DETECTOR_DEFAULT_NMS_IOU 0.5f
+// a time budget splits the work of each thread further, to have places to stop at
+#define DETECTOR_BUDGET_PARTS 4
+
+// One piece of a detector call: a range of pyramid levels over a band of rows
+struct DetectorTask{
+	int y0,y1;
+	float size_min,size_max;
+	int rotation_mode,detector_type;
+	// whether the task got to run before the deadline
+	int ran;
+	int n_faces;
+	Buffer<int>::type rects;
+};
+
+struct ddeutil_detector{
+	WorkerPool* pool;
+	int n_threads;
+	// one dde_core detector per worker of the pool, each task of a call
+	// replays its parameters onto the detector of the worker running it
+	Buffer<void*>::type instances;
+	// whether each detector has been given the size range of a band
+	Buffer<char>::type instance_banded;
+	char param_names[DETECTOR_MAX_PARAMS][32];
+	float param_values[DETECTOR_MAX_PARAMS];
+	int n_params;
+	float nms_iou;
+	// the share of the planned tasks a call runs, and the first task of the next call
+	float scan_fraction;
+	int scan_cursor;
+	// whether a partial pass has tiles left, the next call continues it
+	int scan_pending;
+	// the image size the scan in progress was planned for
+	int scan_w,scan_h;
+	// 0 for no time budget
+	float time_budget_us;
+	std::chrono::steady_clock::time_point deadline;
+	// the best face of the last call that found one, where the next call looks first
+	int has_predicted;
+	float predicted_size,predicted_y;
+	// the tasks of the call, the first n_tasks are in use; the rest keep
+	// their buffers for the next call
+	Buffer<DetectorTask>::type tasks;
+	int n_tasks;
+	Buffer<ddeutil_face_rect>::type candidates;
+	// the scored results of ddeutil_detector_run and _run_all, max_faces of them
+	Buffer<ddeutil_face_rect>::type results;
+	// the call being run
+	const unsigned char* img;
+	int stride,w,max_faces;
+};
+
+ddeutil_detector* ddeutil_detector_create(){
+	ddeutil_detector* d=util_new<ddeutil_detector>();
+	if(!d) return NULL;
+	d->pool=NULL;
+	d->n_tasks=0;
+	d->n_threads=1;
+	d->n_params=0;
+	d->nms_iou=DETECTOR_DEFAULT_NMS_IOU;
+	d->scan_fraction=1.f;
+	d->scan_cursor=0;
+	d->scan_pending=0;
+	d->scan_w=0;
+	d->scan_h=0;
+	d->time_budget_us=0.f;
+	d->has_predicted=0;
+	d->predicted_size=0.f;
+	d->predicted_y=0.f;
+	return d;
+}
+
+void ddeutil_detector_destroy(ddeutil_detector* d){
+	if(!d) return;
+	{
+		CoreLock lock;
+		for(size_t i=0;i<d->instances.size();i++) dde_facedet_destroy(d->instances[i]);
+	}
+	util_delete(d->pool);
+	util_delete(d);
+}
+
+static const float* detector_param(ddeutil_detector* d,const char* name){
+	for(int i=0;i<d->n_params;i++){
+		if(!strcmp(d->param_names[i],name)) return &d->param_values[i];
+	}
+	return NULL;
+}
+
+int ddeutil_detector_set(ddeutil_detector* d,const char* name,const float* pvalue){
+	if(!strcmp(name,"n_threads")){
+		int n_threads=(int)*pvalue;
+		if(n_threads<1) n_threads=1;
+		if(n_threads>DETECTOR_MAX_THREADS) n_threads=DETECTOR_MAX_THREADS;
+		if(n_threads!=d->n_threads){
+			util_delete(d->pool);
+			d->pool=NULL;
+			d->n_threads=n_threads;
+			try{
+				if(n_threads>1) d->pool=util_new<WorkerPool>(n_threads);
+			}catch(...){
+				// no threads to be had, the tasks run unsplit on the caller
+				d->n_threads=1;
+			}
+		}
+		return 1;
+	}
+	if(!strcmp(name,"nms_iou")){
+		d->nms_iou=*pvalue;
+		return 1;
+	}
+	if(!strcmp(name,"scan_fraction")){
+		float fraction=*pvalue;
+		if(!(fraction>0.f)||fraction>1.f) fraction=1.f;
+		d->scan_fraction=fraction;
+		d->scan_cursor=0;
+		d->scan_pending=0;
+		return 1;
+	}
+	if(!strcmp(name,"time_budget_us")){
+		d->time_budget_us=*pvalue>0.f?*pvalue:0.f;
+		return 1;
+	}
+	// the values are replayed on every task's detector right before it runs
+	float* pv=(float*)detector_param(d,name);
+	if(pv){
+		*pv=*pvalue;
+		return 1;
+	}
+	if(d->n_params>=DETECTOR_MAX_PARAMS||strlen(name)>=sizeof(d->param_names[0])) return 0;
+	strcpy(d->param_names[d->n_params],name);
+	d->param_values[d->n_params]=*pvalue;
+	d->n_params++;
+	return 1;
+}
+
+static void detector_add_task(ddeutil_detector* d,int y0,int y1,float size_min,float size_max,int rotation_mode,int detector_type){
+	if(d->n_tasks==(int)d->tasks.size()) d->tasks.push_back(DetectorTask());
+	DetectorTask& task=d->tasks[d->n_tasks++];
+	task.y0=y0;
+	task.y1=y1;
+	task.size_min=size_min;
+	task.size_max=size_max;
+	task.rotation_mode=rotation_mode;
+	task.detector_type=detector_type;
+	task.ran=0;
+	task.n_faces=0;
+}
+
+// Adds the tasks of one rotation mode and detector type: the pyramid levels
+// are split into groups of about equal work, and the heaviest groups further
+// into overlapping bands of rows. A partial scan plans n_threads tasks per
+// call, so that the calls of a pass cost about the same
+static void detector_plan(ddeutil_detector* d,int w,int h,int rotation_mode,int detector_type){
+	int n_parts=d->n_threads;
+	if(d->scan_fraction<1.f) n_parts*=(int)std::ceil(1.f/d->scan_fraction);
+	if(d->time_budget_us>0.f) n_parts*=DETECTOR_BUDGET_PARTS;
+	const float* psize_min=detector_param(d,"size_min");
+	const float* psize_max=detector_param(d,"size_max");
+	const float* pscaling=detector_param(d,"scaling_factor");
+	float size_min=psize_min?*psize_min:0.f;
+	float size_max=psize_max?*psize_max:(float)(w<h?w:h);
+	float scaling=pscaling?*pscaling:1.2f;
+	if(n_parts<=1||size_min<=0.f||size_max<size_min||scaling<=1.f){
+		// nothing to split on, leave the whole call to a single detector
+		detector_add_task(d,0,h,-1.f,-1.f,rotation_mode,detector_type);
+		return;
+	}
+	float levels[256];
+	float work[256];
+	float total=0.f;
+	int n_levels=0;
+	for(float size=size_min;size<=size_max&&n_levels<256;size*=scaling){
+		levels[n_levels]=size;
+		// the number of windows at a level goes with the number of window positions
+		work[n_levels]=((float)w/size)*((float)h/size);
+		total+=work[n_levels];
+		n_levels++;
+	}
+	float target=total/(float)n_parts;
+	for(int first=0;first<n_levels;){
+		int last=first;
+		float group_work=work[first];
+		while(last+1<n_levels&&group_work+work[last+1]<=target*1.25f){
+			last++;
+			group_work+=work[last];
+		}
+		// stop halfway to the next level, so that each level belongs to one group
+		float group_min=levels[first];
+		float group_max=levels[last]*std::sqrt(scaling);
+		if(first==0) group_min=size_min;
+		if(last==n_levels-1) group_max=size_max;
+		int n_bands=(int)(group_work/target+0.5f);
+		if(n_bands<1) n_bands=1;
+		if(n_bands>n_parts) n_bands=n_parts;
+		// bands overlap by the largest window, so that no face is cut in half
+		int overlap=(int)std::ceil(group_max);
+		int band_h=(h+n_bands-1)/n_bands;
+		for(int b=0;b<n_bands;b++){
+			int y0=b*band_h;
+			int y1=y0+band_h+overlap;
+			if(y1>h) y1=h;
+			if(y0>=h) break;
+			detector_add_task(d,y0,y1,group_min,group_max,rotation_mode,detector_type);
+		}
+		first=last+1;
+	}
+}
+
+static void detector_task(void* arg,int i,int worker){
+	ddeutil_detector* d=(ddeutil_detector*)arg;
+	DetectorTask& task=d->tasks[i];
+	// a task that would start past the deadline is dropped, the ones running finish
+	if(d->time_budget_us>0.f&&std::chrono::steady_clock::now()>=d->deadline) return;
+	CoreLock lock;
+	// the lock may have been held by the other tasks for a while, check again
+	if(d->time_budget_us>0.f&&std::chrono::steady_clock::now()>=d->deadline) return;
+	if(task.size_min<=0.f&&d->instance_banded[worker]){
+		// an unsplit task runs on the core's own size range, which only a fresh detector has
+		void* fresh=dde_facedet_create();
+		if(!fresh) return;
+		dde_facedet_destroy(d->instances[worker]);
+		d->instances[worker]=fresh;
+	}
+	d->instance_banded[worker]=task.size_min>0.f;
+	task.ran=1;
+	void* instance=d->instances[worker];
+	for(int k=0;k<d->n_params;k++) dde_facedet_set(instance,d->param_names[k],&d->param_values[k]);
+	if(task.size_min>0.f){
+		dde_facedet_set(instance,"size_min",&task.size_min);
+		dde_facedet_set(instance,"size_max",&task.size_max);
+	}
+	task.n_faces=dde_facedet_run_ex2(instance,d->img+(size_t)task.y0*(size_t)d->stride,d->stride,d->w,task.y1-task.y0,
+		&task.rects[0],d->max_faces,task.rotation_mode,task.detector_type);
+	for(int k=0;k<task.n_faces;k++) task.rects[k*4+1]+=task.y0;
+}
+
+static float rect_iou(const int* a,const int* b){
+	int x0=a[0]>b[0]?a[0]:b[0];
+	int y0=a[1]>b[1]?a[1]:b[1];
+	int x1=a[0]+a[2]<b[0]+b[2]?a[0]+a[2]:b[0]+b[2];
+	int y1=a[1]+a[3]<b[1]+b[3]?a[1]+a[3]:b[1]+b[3];
+	if(x1<=x0||y1<=y0) return 0.f;
+	float inter=(float)(x1-x0)*(float)(y1-y0);
+	return inter/((float)a[2]*(float)a[3]+(float)b[2]*(float)b[3]-inter);
+}
+
+// How far a task is from the predicted face: the ratio between its window
+// sizes and the predicted size first, then the rows between its band and
+// the predicted center
+static float task_distance(const ddeutil_detector* d,const DetectorTask& task){
+	float scale=0.f;
+	if(task.size_min>0.f){
+		if(d->predicted_size<task.size_min) scale=std::log(task.size_min/d->predicted_size);
+		if(d->predicted_size>task.size_max) scale=std::log(d->predicted_size/task.size_max);
+	}
+	float rows=0.f;
+	if(d->predicted_y<(float)task.y0) rows=(float)task.y0-d->predicted_y;
+	if(d->predicted_y>(float)task.y1) rows=d->predicted_y-(float)task.y1;
+	return scale*1e6f+rows;
+}
+
+struct TaskCloser{
+	const ddeutil_detector* d;
+	bool operator()(const DetectorTask& a,const DetectorTask& b)const{
+		return task_distance(d,a)<task_distance(d,b);
+	}
+};
+
+static bool candidate_better(const ddeutil_face_rect& a,const ddeutil_face_rect& b){
+	return a.score>b.score;
+}
+
+// Runs the planned tasks, then votes and suppresses overlapping results:
+// each detection scores the overlap of all detections of the same face,
+// and only the best scoring one of each face is kept
+static int detector_execute(ddeutil_detector* d,const void* img,int stride,int w,ddeutil_face_rect* ret,int max_faces){
+	int n_workers=d->pool?d->pool->size():1;
+	// reserved first, so that a detector just created is never lost to a failed push_back
+	d->instances.reserve(n_workers);
+	d->instance_banded.reserve(n_workers);
+	while((int)d->instances.size()<n_workers){
+		void* instance=NULL;
+		{
+			CoreLock lock;
+			instance=dde_facedet_create();
+		}
+		if(!instance) return 0;
+		d->instances.push_back(instance);
+		d->instance_banded.push_back(0);
+	}
+	if((int)d->instances.size()>n_workers){
+		// fewer threads than before
+		CoreLock lock;
+		while((int)d->instances.size()>n_workers){
+			dde_facedet_destroy(d->instances.back());
+			d->instances.pop_back();
+			d->instance_banded.pop_back();
+		}
+	}
+	d->img=(const unsigned char*)img;
+	d->stride=stride;
+	d->w=w;
+	d->max_faces=max_faces;
+	if(d->time_budget_us>0.f&&d->has_predicted&&d->scan_fraction>=1.f){
+		// the pool claims tasks in order, the likeliest ones should go before the deadline.
+		// A partial scan keeps the plan order, so that the deadline only cuts its tail.
+		TaskCloser closer={d};
+		insertion_sort(&d->tasks[0],d->n_tasks,closer);
+	}
+	for(int i=0;i<d->n_tasks;i++){
+		DetectorTask& task=d->tasks[i];
+		// sized here, so that the workers don't allocate
+		task.rects.resize((size_t)max_faces*4);
+		task.ran=0;
+		task.n_faces=0;
+	}
+	if(d->pool){
+		d->pool->run(detector_task,d,d->n_tasks);
+	}else{
+		for(int i=0;i<d->n_tasks;i++) detector_task(d,i,0);
+	}
+	Buffer<ddeutil_face_rect>::type& cands=d->candidates;
+	cands.clear();
+	for(int i=0;i<d->n_tasks;i++){
+		const DetectorTask& task=d->tasks[i];
+		for(int k=0;k<task.n_faces;k++){
+			ddeutil_face_rect cand;
+			memcpy(cand.rect,&task.rects[(size_t)k*4],sizeof(cand.rect));
+			cand.score=0.f;
+			cand.rotation_mode=task.rotation_mode;
+			cand.detector_type=task.detector_type;
+			cand.n_neighbors=0;
+			cands.push_back(cand);
+		}
+	}
+	for(size_t i=0;i<cands.size();i++){
+		for(size_t j=0;j<cands.size();j++){
+			float iou=rect_iou(cands[i].rect,cands[j].rect);
+			if(iou<=d->nms_iou) continue;
+			cands[i].score+=iou;
+			cands[i].n_neighbors++;
+		}
+	}
+	// stable, so that ties keep the task order, frontal detections first
+	if(!cands.empty()) insertion_sort(&cands[0],(int)cands.size(),candidate_better);
+	int n_faces=0;
+	for(size_t i=0;i<cands.size()&&n_faces<max_faces;i++){
+		int suppressed=0;
+		for(int j=0;j<n_faces&&!suppressed;j++) suppressed=rect_iou(cands[i].rect,ret[j].rect)>d->nms_iou;
+		if(!suppressed) ret[n_faces++]=cands[i];
+	}
+	if(n_faces>0){
+		d->has_predicted=1;
+		d->predicted_size=(float)ret[0].rect[2];
+		d->predicted_y=(float)ret[0].rect[1]+0.5f*(float)ret[0].rect[3];
+	}
+	return n_faces;
+}
+
+static int detector_run_scored(ddeutil_detector* d,const void* img,int stride,int w,int h,ddeutil_face_rect* ret,int max_faces,int mode_mask){
+	if(d->time_budget_us>0.f){
+		d->deadline=std::chrono::steady_clock::now()+std::chrono::microseconds((long long)d->time_budget_us);
+	}
+	d->n_tasks=0;
+	for(int detector_type=DETECTOR_TYPE_FRONTAL_FACE;detector_type<=DETECTOR_TYPE_LEFT_SIDE_FACE;detector_type++){
+		for(int rotation_mode=0;rotation_mode<4;rotation_mode++){
+			if(mode_mask&(1<<(rotation_mode+4*detector_type))) detector_plan(d,w,h,rotation_mode,detector_type);
+		}
+	}
+	if(d->scan_fraction>=1.f) return detector_execute(d,img,stride,w,ret,max_faces);
+	// keep this call's share of the pass, the plan is the same on every call
+	// as long as the parameters and the image size don't change
+	if(w!=d->scan_w||h!=d->scan_h){
+		// another rectangle, the tiles of the pass in progress don't apply to it
+		d->scan_cursor=0;
+		d->scan_w=w;
+		d->scan_h=h;
+	}
+	int n_tasks=d->n_tasks;
+	int n_run=(int)std::ceil(d->scan_fraction*(float)n_tasks);
+	int first=d->scan_cursor<n_tasks?d->scan_cursor:0;
+	if(n_run>n_tasks-first) n_run=n_tasks-first;
+	for(int i=0;i<n_run;i++) std::swap(d->tasks[i],d->tasks[first+i]);
+	d->n_tasks=n_run;
+	int n_faces=detector_execute(d,img,stride,w,ret,max_faces);
+	// move on past the tiles that ran, the ones the deadline dropped go first next time
+	int n_done=0;
+	while(n_done<n_run&&d->tasks[n_done].ran) n_done++;
+	d->scan_cursor=first+n_done<n_tasks?first+n_done:0;
+	d->scan_pending=d->scan_cursor!=0||n_done<n_run;
+	return n_faces;
+}
+
+int ddeutil_detector_run_scored(ddeutil_detector* d,const void* img,int stride,int w,int h,ddeutil_face_rect* ret,int max_faces,int mode_mask){
+	if(max_faces<=0) return 0;
+	try{
+		return detector_run_scored(d,img,stride,w,h,ret,max_faces,mode_mask);
+	}catch(...){
+		// the tasks and candidates are only ever grown, the detector stays usable
+		return 0;
+	}
+}
+
+int ddeutil_detector_run(ddeutil_detector* d,const void* img,int stride,int w,int h,int* ret,int max_faces,int rotation_mode,int detector_type){
+	return ddeutil_detector_run_all(d,img,stride,w,h,ret,NULL,max_faces,1<<(rotation_mode+4*detector_type));
+}
+
+int ddeutil_detector_run_all(ddeutil_detector* d,const void* img,int stride,int w,int h,int* ret,int* modes,int max_faces,int mode_mask){
+	if(max_faces<=0) return 0;
+	try{
+		// kept from call to call, so that only a larger max_faces allocates
+		if(d->results.size()<(size_t)max_faces) d->results.resize((size_t)max_faces);
+	}catch(...){
+		return 0;
+	}
+	ddeutil_face_rect* faces=&d->results[0];
+	int n_faces=ddeutil_detector_run_scored(d,img,stride,w,h,faces,max_faces,mode_mask);
+	for(int i=0;i<n_faces;i++){
+		memcpy(ret+i*4,faces[i].rect,sizeof(faces[i].rect));
+		if(modes) modes[i]=faces[i].rotation_mode+4*faces[i].detector_type;
+	}
+	return n_faces;
+}
+
+/////////////////////////////////////////////////////////////////
+// tracking sessions
+
+// adaptive copies run another copy above this stress, or until the update of
+// the last copy falls below the tolerance
+#define STRESS_ESCALATE 1.f
+#define DEFAULT_TOLERANCE 0.02f
+// the update is measured on up to this many landmark coordinates
+#define UPDATE_MAX_COORDS 256
+
+struct ddeutil_session{
+	ddeutil_detector* detector;
+	WorkerPool* pool;
+	// binds the images passed to ddeutil_session_run
+	ddeutil_frame* frame;
+	int max_faces;
+	TWorkArea* contexts[DDEUTIL_MAX_FACES];
+	// the contexts live side by side in one cache-line aligned slab, allocated
+	// up front for slab_faces faces
+	void* context_slab;
+	int slab_faces;
+	// bitmask of the contexts holding a face
+	unsigned int tracked;
+	unsigned int rng;
+	int schedule;
+	// detection attempts since the last reset, drives the detector schedule
+	unsigned int attempts;
+	int rmode_next;
+	int rmode_default;
+	int rmode_detected;
+	// the parameters and the rectangle, x0,y0,x1,y1, of the partial scan in progress
+	float scan_size_min,scan_min_neighbors;
+	int scan_rmode,scan_detector_type;
+	int scan_roi[4];
+	// the motion gate, off while motion_threshold is 0
+	int motion_threshold,motion_history,motion_full_scan_period;
+	int motion_level,motion_w,motion_h,motion_bw,motion_bh;
+	int frames_since_full_scan;
+	unsigned char* motion_prev;
+	// frames since each block last changed
+	unsigned short* block_age;
+	// tracker copies per frame, and the number each face ran on the last frame
+	int copies_min,copies_max;
+	float tolerance;
+	int copies_run[DDEUTIL_MAX_FACES];
+	// the identity lock, off while identity_tolerance is 0
+	float identity_tolerance,identity_w_locked,identity_w_unlocked;
+	int identity_frames;
+	float identity_prev[DDEUTIL_MAX_FACES][N_IDENTITIES];
+	int identity_stable[DDEUTIL_MAX_FACES];
+	char identity_locked[DDEUTIL_MAX_FACES];
+};
+
+static unsigned int session_rand(ddeutil_session* s){
+	// xorshift32, private to the session so that sessions don't contend on rand()
+	unsigned int x=s->rng;
+	x^=x<<13;
+	x^=x>>17;
+	x^=x<<5;
+	s->rng=x;
+	return x;
+}
+
+static float session_randf(ddeutil_session* s){
+	return (float)(session_rand(s)>>8)*(1.f/16777216.f);
+}
+
+// The detector schedule. Each detection attempt picks a rotation mode, a
+// detector type slot and a size_min bin, with the rotation changing fastest.
+// Counting the attempts in mixed radix visits every combination exactly once
+// per sweep of SCHEDULE_ROTATIONS*SCHEDULE_TYPE_SLOTS*SCHEDULE_SCALE_BINS
+// attempts; fixed rotation or disabled side faces shrink the sweep.
+#define SCHEDULE_ROTATIONS 4
+#define SCHEDULE_TYPE_SLOTS 4
+#define SCHEDULE_SCALE_BINS 4
+// frontal in every other slot, as often as the randomized easydde schedule tries it
+static const int g_schedule_types[SCHEDULE_TYPE_SLOTS]={
+	DETECTOR_TYPE_FRONTAL_FACE,DETECTOR_TYPE_RIGHT_SIDE_FACE,
+	DETECTOR_TYPE_FRONTAL_FACE,DETECTOR_TYPE_LEFT_SIDE_FACE,
+};
+// bins in bit-reversed order, so that early attempts are spread over the range
+static const int g_schedule_bins[SCHEDULE_SCALE_BINS]={0,2,1,3};
+
+// van der Corput radical inverse in base 2
+static float radical_inverse(unsigned int i){
+	i=(i<<16)|(i>>16);
+	i=((i&0x00ff00ffu)<<8)|((i&0xff00ff00u)>>8);
+	i=((i&0x0f0f0f0fu)<<4)|((i&0xf0f0f0f0u)>>4);
+	i=((i&0x33333333u)<<2)|((i&0xccccccccu)>>2);
+	i=((i&0x55555555u)<<1)|((i&0xaaaaaaaau)>>1);
+	return (float)(i>>8)*(1.f/16777216.f);
+}
+
+// Picks the detector parameters of the next detection attempt
+static void session_detector_params(ddeutil_session* s,int flags,int h,float* psize_min,float* pmin_neighbors,int* prmode,int* pdetector_type){
+	int rmode=s->rmode_default;
+	int detector_type=DETECTOR_TYPE_FRONTAL_FACE;
+	// randomize the minimal face size to cover the default scaling_factor of 1.2
+	float size_pos=0.f;
+	if(s->schedule==DDEUTIL_SCHEDULE_RANDOM){
+		size_pos=session_randf(s);
+		if(!(flags&FLAG_DISABLE_ROTATION)){
+			rmode=s->rmode_next;
+			s->rmode_next=(int)(session_rand(s)>>30);
+		}
+		if(!(flags&FLAG_DISABLE_SIDE_FACE)&&(session_rand(s)&1u)){
+			detector_type=(session_rand(s)&1u)?DETECTOR_TYPE_RIGHT_SIDE_FACE:DETECTOR_TYPE_LEFT_SIDE_FACE;
+		}
+	}else{
+		unsigned int n=s->attempts;
+		int n_rotations=(flags&FLAG_DISABLE_ROTATION)?1:SCHEDULE_ROTATIONS;
+		int n_slots=(flags&FLAG_DISABLE_SIDE_FACE)?1:SCHEDULE_TYPE_SLOTS;
+		unsigned int sweep_len=(unsigned int)(n_rotations*n_slots*SCHEDULE_SCALE_BINS);
+		// start from the orientation that found a face last
+		if(n_rotations>1) rmode=(s->rmode_next+(int)(n%SCHEDULE_ROTATIONS))&3;
+		n/=(unsigned int)n_rotations;
+		detector_type=g_schedule_types[n%(unsigned int)n_slots];
+		n/=(unsigned int)n_slots;
+		int bin=g_schedule_bins[n%SCHEDULE_SCALE_BINS];
+		// successive sweeps fill each bin with a low-discrepancy sequence
+		size_pos=((float)bin+radical_inverse(s->attempts/sweep_len))*(1.f/(float)SCHEDULE_SCALE_BINS);
+	}
+	s->attempts++;
+	*psize_min=((50.f/480.f)+size_pos*(20.f/480.f))*(float)h;
+	// the side-face detector has less false positives and min_neighbors==1 is enough
+	*pmin_neighbors=detector_type==DETECTOR_TYPE_FRONTAL_FACE?3.f:1.f;
+	*prmode=rmode;
+	*pdetector_type=detector_type;
+}
+
+// Makes the sweep try rmode first: the next attempt starts a round of
+// rotations, which counts from rmode_next
+static void session_set_rmode_next(ddeutil_session* s,int rmode,int flags){
+	if(rmode==s->rmode_next) return;
+	if(!(flags&FLAG_DISABLE_ROTATION)) s->attempts-=s->attempts%SCHEDULE_ROTATIONS;
+	s->rmode_next=rmode;
+}
+
+// Allocates the contexts of n_faces faces. When the slab has to grow, the
+// new one replaces it only once allocated, and the caller drops the
+// tracked faces; on failure the old slab and its faces are kept.
+static int session_alloc_contexts(ddeutil_session* s,int n_faces){
+	if(s->slab_faces>=n_faces) return 1;
+	// dde_create_context for all faces at once, on the caller's allocator
+	void* slab=util_calloc(context_stride()*(size_t)n_faces+CACHE_LINE);
+	if(!slab) return 0;
+	util_free(s->context_slab);
+	s->context_slab=slab;
+	s->slab_faces=n_faces;
+	size_t base=((size_t)s->context_slab+CACHE_LINE-1)&~(size_t)(CACHE_LINE-1);
+	for(int i=0;i<DDEUTIL_MAX_FACES;i++){
+		s->contexts[i]=i<s->slab_faces?(TWorkArea*)(base+context_stride()*(size_t)i):NULL;
+		s->identity_locked[i]=0;
+		s->identity_stable[i]=0;
+	}
+	return 1;
+}
+
+// The index of the lowest set bit of a non-zero x, by de Bruijn multiplication
+static int lowest_bit(unsigned int x){
+	static const int index[32]={
+		0,1,28,2,29,14,24,3,30,22,20,15,25,17,4,8,
+		31,27,13,23,21,19,16,7,26,12,18,6,11,5,10,9,
+	};
+	return index[((x&(0u-x))*0x077cb531u)>>27];
+}
+
+ddeutil_session* ddeutil_session_create(int max_faces){
+	if(max_faces<1) max_faces=1;
+	if(max_faces>DDEUTIL_MAX_FACES) max_faces=DDEUTIL_MAX_FACES;
+	ddeutil_session* s=(ddeutil_session*)util_calloc(sizeof(ddeutil_session));
+	if(!s) return NULL;
+	s->detector=ddeutil_detector_create();
+	s->max_faces=max_faces;
+	s->copies_min=1;
+	s->copies_max=1;
+	s->tolerance=DEFAULT_TOLERANCE;
+	ddeutil_session_seed(s,0);
+	if(!s->detector||!session_alloc_contexts(s,max_faces)){
+		ddeutil_session_destroy(s);
+		return NULL;
+	}
+	return s;
+}
+
+void ddeutil_session_destroy(ddeutil_session* s){
+	if(!s) return;
+	util_free(s->context_slab);
+	ddeutil_detector_destroy(s->detector);
+	util_delete(s->pool);
+	ddeutil_frame_destroy(s->frame);
+	util_free(s->motion_prev);
+	util_free(s->block_age);
+	util_free(s);
+}
+
+// Copies the landmarks of a context and returns their number of
+// coordinates, the caller holds the core lock
+static int context_landmarks(TWorkArea* ctx,float* lm){
+	int dim=0;
+	float* p=dde_get(ctx,"landmarks",&dim);
+	if(!p||dim<2) return 0;
+	if(dim>UPDATE_MAX_COORDS) dim=UPDATE_MAX_COORDS;
+	memcpy(lm,p,sizeof(float)*(size_t)dim);
+	return dim;
+}
+
+// The root mean square landmark displacement between two results,
+// relative to the face width
+static float landmark_update(const float* a,const float* b,int dim){
+	float x0=b[0],x1=b[0];
+	float sum=0.f;
+	for(int j=0;j+1<dim;j+=2){
+		float dx=b[j]-a[j],dy=b[j+1]-a[j+1];
+		sum+=dx*dx+dy*dy;
+		if(b[j]<x0) x0=b[j];
+		if(b[j]>x1) x1=b[j];
+	}
+	if(x1<=x0) return 0.f;
+	return std::sqrt(sum/(float)(dim/2))/(x1-x0);
+}
+
+static void session_set_identity_weight(ddeutil_session* s,int slot,int locked){
+	float weight=locked?s->identity_w_locked:s->identity_w_unlocked;
+	dde_set(s->contexts[slot],"w_smooth_identity",&weight);
+	s->identity_locked[slot]=(char)locked;
+	s->identity_stable[slot]=0;
+}
+
+// Locks the identity of a face once it has held still for identity_frames
+// frames, and unlocks it as soon as the tracker gets stressed. The caller
+// holds the core lock.
+static void session_update_identity_lock(ddeutil_session* s,int slot,float stress_value){
+	if(!s->identity_tolerance) return;
+	if(s->identity_locked[slot]){
+		if(stress_value>STRESS_ESCALATE) session_set_identity_weight(s,slot,0);
+		return;
+	}
+	int dim=0;
+	float* identity=dde_get(s->contexts[slot],"identity",&dim);
+	if(!identity||dim<N_IDENTITIES) return;
+	float change=0.f;
+	for(int j=0;j<N_IDENTITIES;j++){
+		float d=identity[j]-s->identity_prev[slot][j];
+		change+=d*d;
+	}
+	memcpy(s->identity_prev[slot],identity,sizeof(s->identity_prev[slot]));
+	if(std::sqrt(change)>s->identity_tolerance||stress_value>STRESS_ESCALATE){
+		s->identity_stable[slot]=0;
+	}else if(++s->identity_stable[slot]>=s->identity_frames){
+		session_set_identity_weight(s,slot,1);
+	}
+}
+
+// Runs the tracker on a face and returns 1 for a valid result, 0 for
+// an unconfident one and -1 when the face is lost. Runs between
+// copies_min and copies_max copies: another one as long as the last
+// one left the face stressed or hadn't converged yet.
+static int session_track(ddeutil_session* s,int slot, const void* img,int stride,int w,int h,int flags){
+	TWorkArea* ctx=s->contexts[slot];
+	CoreLock lock;
+	float stress_value=0.f;
+	float lm[2][UPDATE_MAX_COORDS];
+	int cur=0;
+	int dim=context_landmarks(ctx,lm[cur]);
+	int copies=0;
+	for(;;){
+		if(hldde_next(ctx,(void*)img,stride,w,h)<=0){
+			s->copies_run[slot]=copies+1;
+			return -1;
+		}
+		copies++;
+		int sdim=0;
+		float* stress=dde_get(ctx,"face_confirmation_failure_stress",&sdim);
+		stress_value=stress&&sdim>0?stress[0]:0.f;
+		if(copies>=s->copies_max) break;
+		int next_dim=context_landmarks(ctx,lm[cur^1]);
+		float update=0.f;
+		if(next_dim==dim&&dim>0) update=landmark_update(lm[cur],lm[cur^1],dim);
+		cur^=1;
+		dim=next_dim;
+		if(copies>=s->copies_min&&stress_value<=STRESS_ESCALATE&&update<=s->tolerance) break;
+	}
+	s->copies_run[slot]=copies;
+	session_update_identity_lock(s,slot,stress_value);
+	if(stress_value>STRESS_RESET) return -1;
+	if(stress_value>STRESS_INVALID) return 0;
+	if(flags&DDEUTIL_FLAG_RUN_OPTICAL_FLOW) ddear_run_optical_flow(ctx,img,stride,w,h,0);
+	return 1;
+}
+
+struct TrackJob{
+	ddeutil_session* s;
+	const int* slots;
+	int* results;
+	const void* img;
+	int stride,w,h,flags;
+};
+
+static void track_job_task(void* arg,int task,int){
+	TrackJob* job=(TrackJob*)arg;
+	job->results[task]=session_track(job->s,job->slots[task],job->img,job->stride,job->w,job->h,job->flags);
+}
+
+// Tracks the faces in `slots` on the session pool, one task per face
+static void session_track_slots(ddeutil_session* s,const int* slots,int n,int* results, const void* img,int stride,int w,int h,int flags){
+	TrackJob job={s,slots,results,img,stride,w,h,flags};
+	if(s->pool){
+		s->pool->run(track_job_task,&job,n);
+	}else{
+		for(int i=0;i<n;i++) track_job_task(&job,i,0);
+	}
+}
+
+// Checks whether the center of a detected rect falls onto an already tracked face
+static int session_overlaps_tracked(ddeutil_session* s,const int* rect){
+	CoreLock lock;
+	float cx=(float)rect[0]+0.5f*(float)rect[2];
+	float cy=(float)rect[1]+0.5f*(float)rect[3];
+	for(int i=0;i<s->max_faces;i++){
+		if(!(s->tracked&(1u<<i))) continue;
+		float box[4];
+		if(!context_landmark_bounds(s->contexts[i],box)) continue;
+		if(cx>=box[0]&&cx<=box[2]&&cy>=box[1]&&cy<=box[3]) return 1;
+	}
+	return 0;
+}
+
+// the motion gate compares blocks of MOTION_BLOCK^2 pixels on the coarsest
+// pyramid level that is at least MOTION_MIN_WIDTH wide, level 3 at most
+#define MOTION_BLOCK 4
+#define MOTION_MIN_WIDTH 64
+#define MOTION_MAX_LEVEL 3
+
+// Updates the motion gate and picks the part of the frame the detector
+// scans, x0,y0,x1,y1, given the largest window it scans with. Returns 0
+// when nothing has moved lately.
+static int session_motion_gate(ddeutil_session* s,ddeutil_frame* frame,float window,int* roi){
+	roi[0]=0;
+	roi[1]=0;
+	roi[2]=frame->w;
+	roi[3]=frame->h;
+	if(!s->motion_threshold) return 1;
+	int level=0;
+	while(level<MOTION_MAX_LEVEL&&(frame->w>>(level+1))>=MOTION_MIN_WIDTH) level++;
+	int gw=0,gh=0,gstride=0;
+	const unsigned char* gray=ddeutil_frame_get_gray(frame,level,&gw,&gh,&gstride);
+	if(!gray) return 1;
+	int bw=gw/MOTION_BLOCK,bh=gh/MOTION_BLOCK;
+	if(level!=s->motion_level||gw!=s->motion_w||gh!=s->motion_h||!s->motion_prev){
+		// a new image size, start over from a full scan
+		util_free(s->motion_prev);
+		util_free(s->block_age);
+		s->motion_prev=(unsigned char*)util_alloc((size_t)gw*(size_t)gh);
+		s->block_age=(unsigned short*)util_alloc(sizeof(unsigned short)*(size_t)(bw*bh>0?bw*bh:1));
+		if(!s->motion_prev||!s->block_age){
+			// both or neither, so that the next frame tries again
+			util_free(s->motion_prev);
+			util_free(s->block_age);
+			s->motion_prev=NULL;
+			s->block_age=NULL;
+			return 1;
+		}
+		for(int y=0;y<gh;y++) memcpy(s->motion_prev+(size_t)y*(size_t)gw,gray+(size_t)y*(size_t)gstride,(size_t)gw);
+		// this frame gets a full scan, so nothing is pending
+		for(int i=0;i<bw*bh;i++) s->block_age[i]=0xffff;
+		s->motion_level=level;
+		s->motion_w=gw;
+		s->motion_h=gh;
+		s->motion_bw=bw;
+		s->motion_bh=bh;
+		s->frames_since_full_scan=0;
+		return 1;
+	}
+	int bx0=bw,by0=bh,bx1=-1,by1=-1;
+	for(int by=0;by<bh;by++){
+		for(int bx=0;bx<bw;bx++){
+			int sad=0;
+			for(int y=by*MOTION_BLOCK;y<(by+1)*MOTION_BLOCK;y++){
+				const unsigned char* a=gray+(size_t)y*(size_t)gstride+bx*MOTION_BLOCK;
+				unsigned char* b=s->motion_prev+(size_t)y*(size_t)gw+bx*MOTION_BLOCK;
+				for(int x=0;x<MOTION_BLOCK;x++){
+					sad+=a[x]>b[x]?a[x]-b[x]:b[x]-a[x];
+					b[x]=a[x];
+				}
+			}
+			unsigned short& age=s->block_age[by*bw+bx];
+			if(sad>s->motion_threshold*MOTION_BLOCK*MOTION_BLOCK){
+				age=0;
+			}else if(age<0xffff){
+				age++;
+			}
+			if(age<s->motion_history){
+				if(bx<bx0) bx0=bx;
+				if(by<by0) by0=by;
+				if(bx>bx1) bx1=bx;
+				if(by>by1) by1=by;
+			}
+		}
+	}
+	if(++s->frames_since_full_scan>=s->motion_full_scan_period&&s->motion_full_scan_period>0){
+		s->frames_since_full_scan=0;
+		return 1;
+	}
+	if(bx1<0) return 0;
+	// grow the moving blocks so that a face partly in them fits in the scan
+	int cell=MOTION_BLOCK<<level;
+	int margin=cell>(int)std::ceil(window)?cell:(int)std::ceil(window);
+	roi[0]=bx0*cell-margin;
+	roi[1]=by0*cell-margin;
+	roi[2]=(bx1+1)*cell+margin;
+	roi[3]=(by1+1)*cell+margin;
+	if(roi[0]<0) roi[0]=0;
+	if(roi[1]<0) roi[1]=0;
+	if(roi[2]>frame->w) roi[2]=frame->w;
+	if(roi[3]>frame->h) roi[3]=frame->h;
+	return 1;
+}
+
+static int session_run_frame(ddeutil_session* s, int* p_invalidation_mask, ddeutil_frame* frame,int flags){
+	int stride=0;
+	const void* img=frame_core_image(frame,&stride);
+	int w=frame->w,h=frame->h;
+	unsigned int valid=0,invalidated=0;
+	int slots[DDEUTIL_MAX_FACES],results[DDEUTIL_MAX_FACES];
+	int n_slots=0;
+	for(int i=0;i<s->max_faces;i++){
+		if(s->tracked&(1u<<i)) slots[n_slots++]=i;
+	}
+	session_track_slots(s,slots,n_slots,results,img,stride,w,h,flags);
+	for(int k=0;k<n_slots;k++){
+		int i=slots[k];
+		if(results[k]<0){
+			s->tracked&=~(1u<<i);
+			invalidated|=1u<<i;
+		}else if(results[k]>0){
+			valid|=1u<<i;
+		}
+	}
+	int n_free=0;
+	for(int i=0;i<s->max_faces;i++){
+		if(!(s->tracked&(1u<<i))) n_free++;
+	}
+	int roi[4];
+	// the largest window the detector scans with, a face that big can reach into the moving blocks
+	const float* psize_max=detector_param(s->detector,"size_max");
+	float window=psize_max?*psize_max:(float)(w<h?w:h);
+	// the gate runs on every frame, so that it knows what moved since the last detection
+	int moved=session_motion_gate(s,frame,window,roi);
+	// a partial scan keeps its parameters and its rectangle until it has covered it
+	int scanning=s->detector->scan_pending&&s->scan_roi[2]<=w&&s->scan_roi[3]<=h;
+	if(!scanning){
+		s->detector->scan_cursor=0;
+		s->detector->scan_pending=0;
+	}
+	if(n_free>0&&(moved||scanning)){
+		if(scanning){
+			memcpy(roi,s->scan_roi,sizeof(roi));
+		}else{
+			session_detector_params(s,flags,h,&s->scan_size_min,&s->scan_min_neighbors,&s->scan_rmode,&s->scan_detector_type);
+			memcpy(s->scan_roi,roi,sizeof(roi));
+		}
+		float size_min=s->scan_size_min,min_neighbors=s->scan_min_neighbors;
+		int rmode=s->scan_rmode,detector_type=s->scan_detector_type;
+		int rects[DDEUTIL_MAX_FACES*4];
+		ddeutil_detector_set(s->detector,"size_min",&size_min);
+		ddeutil_detector_set(s->detector,"min_neighbors",&min_neighbors);
+		int det_stride=0;
+		float is_mono=0.f;
+		const void* det_img=frame_detector_image(frame,&det_stride,&is_mono);
+		ddeutil_detector_set(s->detector,"is_mono",&is_mono);
+		int bpp=is_mono!=0.f?1:4;
+		const unsigned char* roi_img=(const unsigned char*)det_img+(size_t)roi[1]*(size_t)det_stride+(size_t)roi[0]*(size_t)bpp;
+		int n_faces=ddeutil_detector_run(s->detector,roi_img,det_stride,roi[2]-roi[0],roi[3]-roi[1],rects,n_free,rmode,detector_type);
+		for(int k=0;k<n_faces;k++){
+			rects[k*4]+=roi[0];
+			rects[k*4+1]+=roi[1];
+		}
+		// claim a free slot for every new face, then run their first frame together
+		unsigned int all=s->max_faces<32?(1u<<s->max_faces)-1u:~0u;
+		unsigned int claimed=s->tracked;
+		n_slots=0;
+		for(int k=0;k<n_faces;k++){
+			const int* rect=rects+k*4;
+			if(session_overlaps_tracked(s,rect)) continue;
+			if(!(all&~claimed)) break;
+			int i=lowest_bit(all&~claimed);
+			float bb[4]={(float)rect[0],(float)rect[1],(float)(rect[0]+rect[2]),(float)(rect[1]+rect[3])};
+			{
+				CoreLock lock;
+				dde_init_context_ex(s->contexts[i],bb,w,h,rmode+4*detector_type,NULL);
+				// a new face starts over with a free identity
+				if(s->identity_locked[i]) session_set_identity_weight(s,i,0);
+				s->identity_stable[i]=0;
+			}
+			claimed|=1u<<i;
+			slots[n_slots++]=i;
+		}
+		session_track_slots(s,slots,n_slots,results,img,stride,w,h,flags);
+		for(int k=0;k<n_slots;k++){
+			int i=slots[k];
+			if(results[k]<0) continue;
+			s->tracked|=1u<<i;
+			s->rmode_detected=rmode;
+			session_set_rmode_next(s,rmode,flags);
+			if(results[k]>0) valid|=1u<<i;
+		}
+	}
+	if(p_invalidation_mask) *p_invalidation_mask=(int)invalidated;
+	return (int)valid;
+}
+
+int ddeutil_session_run(ddeutil_session* s, int* p_invalidation_mask, const void* img,int stride,int w,int h,int flags){
+	if(!s->frame){
+		s->frame=ddeutil_frame_create(img,stride,w,h,flags);
+		if(!s->frame){
+			if(p_invalidation_mask) *p_invalidation_mask=0;
+			return 0;
+		}
+	}else{
+		ddeutil_frame_set(s->frame,img,stride,w,h,flags);
+	}
+	return ddeutil_session_run_frame(s,p_invalidation_mask,s->frame,flags);
+}
+
+int ddeutil_session_run_frame(ddeutil_session* s, int* p_invalidation_mask, ddeutil_frame* frame,int flags){
+	try{
+		return session_run_frame(s,p_invalidation_mask,frame,flags);
+	}catch(...){
+		// only the frame's 32-bit copy can fail, before any face is touched
+		if(p_invalidation_mask) *p_invalidation_mask=0;
+		return 0;
+	}
+}
+
+ddeutil_detector* ddeutil_session_get_detector(ddeutil_session* s){
+	return s->detector;
+}
+
+TWorkArea* ddeutil_session_get_context(ddeutil_session* s,int face_id){
+	if(face_id<0||face_id>=DDEUTIL_MAX_FACES) return NULL;
+	return s->contexts[face_id];
+}
+
+int ddeutil_session_get_data(ddeutil_session* s,int face_id,float* ret,int szret,const char* name){
+	if(face_id<0||face_id>=s->max_faces||!(s->tracked&(1u<<face_id))) return 0;
+	CoreLock lock;
+	int dim=0;
+	float* p=dde_get(s->contexts[face_id],name,&dim);
+	if(!p||dim<=0) return 0;
+	if(ret&&szret>0) memcpy(ret,p,sizeof(float)*(size_t)(szret<dim?szret:dim));
+	return dim;
+}
+
+int ddeutil_session_set_n_copies(ddeutil_session* s,int copies_min,int copies_max){
+	if(copies_min<1) copies_min=1;
+	if(copies_max<copies_min) copies_max=copies_min;
+	s->copies_min=copies_min;
+	s->copies_max=copies_max;
+	return 1;
+}
+
+int ddeutil_session_set_tolerance(ddeutil_session* s,float tolerance){
+	s->tolerance=tolerance>0.f?tolerance:0.f;
+	return 1;
+}
+
+int ddeutil_session_set_identity_lock(ddeutil_session* s,float tolerance,int n_frames,float w_locked,float w_unlocked){
+	s->identity_tolerance=tolerance>0.f?tolerance:0.f;
+	s->identity_frames=n_frames>1?n_frames:1;
+	s->identity_w_locked=w_locked;
+	s->identity_w_unlocked=w_unlocked;
+	CoreLock lock;
+	for(int i=0;i<s->max_faces;i++){
+		if(s->contexts[i]&&s->identity_locked[i]) session_set_identity_weight(s,i,0);
+		s->identity_stable[i]=0;
+	}
+	return 1;
+}
+
+int ddeutil_session_get_identity_locked(ddeutil_session* s){
+	unsigned int mask=0;
+	for(int i=0;i<s->max_faces;i++){
+		if((s->tracked&(1u<<i))&&s->identity_locked[i]) mask|=1u<<i;
+	}
+	return (int)mask;
+}
+
+int ddeutil_session_get_n_copies(ddeutil_session* s,int face_id){
+	if(face_id<0||face_id>=s->max_faces||!(s->tracked&(1u<<face_id))) return 0;
+	return s->copies_run[face_id];
+}
+
+int ddeutil_session_hasface(ddeutil_session* s){
+	return (int)s->tracked;
+}
+
+void ddeutil_session_reset(ddeutil_session* s){
+	s->tracked=0;
+	s->attempts=0;
+	s->rmode_next=s->rmode_default;
+}
+
+int ddeutil_session_set_max_faces(ddeutil_session* s,int max_faces){
+	int prev=s->max_faces;
+	if(max_faces<1) max_faces=1;
+	if(max_faces>DDEUTIL_MAX_FACES) max_faces=DDEUTIL_MAX_FACES;
+	if(max_faces>s->slab_faces){
+		// the contexts move to a larger slab, the faces start over
+		if(!session_alloc_contexts(s,max_faces)) return 0;
+		s->tracked=0;
+		s->max_faces=max_faces;
+	}else{
+		s->max_faces=max_faces;
+		s->tracked&=max_faces<32?(1u<<max_faces)-1u:~0u;
+	}
+	return prev;
+}
+
+int ddeutil_session_drop_face(ddeutil_session* s,int face_id){
+	if(face_id<0||face_id>=s->max_faces||!(s->tracked&(1u<<face_id))) return 0;
+	s->tracked&=~(1u<<face_id);
+	return 1;
+}
+
+void ddeutil_session_seed(ddeutil_session* s,unsigned int seed){
+	// xorshift32 must not start from 0
+	s->rng=seed*2654435761u^0x9e3779b9u;
+	if(!s->rng) s->rng=0x9e3779b9u;
+	s->attempts=0;
+}
+
+int ddeutil_session_set_schedule(ddeutil_session* s,int schedule){
+	int prev=s->schedule;
+	s->schedule=schedule==DDEUTIL_SCHEDULE_RANDOM?DDEUTIL_SCHEDULE_RANDOM:DDEUTIL_SCHEDULE_SWEEP;
+	s->attempts=0;
+	return prev;
+}
+
+int ddeutil_session_get_rotation_mode(ddeutil_session* s){
+	return s->rmode_detected;
+}
+
+void ddeutil_session_set_motion_gate(ddeutil_session* s,int threshold,int history,int full_scan_period){
+	s->motion_threshold=threshold>0?threshold:0;
+	s->motion_history=history>1?history:1;
+	s->motion_full_scan_period=full_scan_period>0?full_scan_period:0;
+	// the next frame starts over
+	util_free(s->motion_prev);
+	s->motion_prev=NULL;
+}
+
+void ddeutil_session_set_default_orientation(ddeutil_session* s,int rmode){
+	s->rmode_default=rmode&3;
+	if(!s->tracked) session_set_rmode_next(s,s->rmode_default,0);
+}
+
+int ddeutil_session_set_n_threads(ddeutil_session* s,int n_threads){
+	int prev=s->pool?s->pool->size():1;
+	if(n_threads<1) n_threads=1;
+	if(n_threads>DDEUTIL_MAX_FACES) n_threads=DDEUTIL_MAX_FACES;
+	if(n_threads!=prev){
+		util_delete(s->pool);
+		s->pool=NULL;
+		try{
+			if(n_threads>1) s->pool=util_new<WorkerPool>(n_threads);
+		}catch(...){
+			// no threads to be had, the faces are tracked on the caller
+		}
+	}
+	return prev;
+}
@@ -0,0 +1,783 @@
+#pragma once
+#ifndef DDE_UTIL_H
+#define DDE_UTIL_H
+#include "ddeface.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/***************************************************************
+Here go the helper functions built on top of the public API in
+`ddeface.h`. They are shipped as source: compile ddeutil.cpp
+into your application alongside the code that uses them.
+***************************************************************/
+
+/**
+\brief Map v3.bin read-only into memory and pass it to `dde_setup`.
+       Unlike reading the file into a heap buffer, the mapping is
+       backed by the page cache, so processes on the same host
+       share one copy of the tables and nothing is copied up front.
+       The mapping is kept for the lifetime of the process.
+\param path is the path to v3.bin
+\param authdata points to the authentication package, refer to
+       `dde_setup` for details.
+\param authdata_sz is the size of the authentication package.
+\return the return value of `dde_setup`, or -1 when the file
+        cannot be opened or mapped
+*/
+int ddeutil_setup_from_file(const char* path, const void* authdata,int authdata_sz);
+
+/***************************************************************
+Here goes the memory control. Frames, detectors, sessions, the
+contexts sessions create, identity caches and the canvases of
+`ddeutil_track_roi` take their memory from one allocator, which
+the application can supply. Once a session has seen its
+first frames at a given size and number of faces, running it
+allocates nothing, which `ddeutil_get_alloc_count` lets tests
+check. Memory dde_core allocates internally is outside its reach.
+When an allocation fails, no exception leaves ddeutil: the function
+returns 0 or NULL, and a later call retries the allocation. Thread
+counts that can't be had fall back to a single thread.
+***************************************************************/
+
+/// \brief An allocation function, receives the `user` pointer passed to `ddeutil_set_allocator`
+typedef void* (*ddeutil_alloc_func)(size_t size,void* user);
+/// \brief The matching release function
+typedef void (*ddeutil_free_func)(void* p,void* user);
+
+/**
+\brief Set the allocator of the ddeutil objects. Only change it while
+       no ddeutil object exists and no other thread is inside a
+       ddeutil function. A `ddeutil_track_roi` canvas may outlive
+       the change: it keeps the functions it was allocated with and
+       returns its memory to them when its thread exits. The
+       functions may be called from any thread that runs ddeutil
+       functions, and the returned memory must be aligned as
+       malloc's.
+\param alloc_func allocates memory. NULL restores malloc and free.
+\param free_func releases memory from `alloc_func`
+\param user is passed to both functions
+*/
+void ddeutil_set_allocator(ddeutil_alloc_func alloc_func,ddeutil_free_func free_func,void* user);
+/**
+\brief Get the number of allocations the ddeutil objects have made so
+       far. Tests can compare it before and after a run of frames to
+       assert the steady state allocates nothing.
+*/
+unsigned int ddeutil_get_alloc_count();
+
+/***************************************************************
+Here goes the batched tracking API. It advances many contexts on
+the same frame in one call, spreading them over a process-wide
+worker pool.
+***************************************************************/
+
+/**
+\brief Set the number of threads used by `ddeutil_track_batch`. The
+       calling thread is one of them. The default is 1, i.e. no
+       extra threads.
+\remark The contexts still take turns while dde_core calls are
+        serialized, refer to `ddeutil_set_core_serialization`.
+\param n_threads is the new number of threads
+\return the previous number of threads
+*/
+int ddeutil_set_batch_threads(int n_threads);
+
+/**
+\brief Feed the same image frame to `n` tracker contexts. It's
+       equivalent to calling `hldde_next` on each context, but the
+       contexts are spread over the threads of the batch pool. A
+       batch started while another one holds the pool runs on the
+       calling thread.
+\remark The contexts still take turns while dde_core calls are
+        serialized, the default: a batch only runs in parallel
+        after `ddeutil_set_core_serialization(0)`.
+\param contexts points to `n` distinct tracker contexts
+\param n is the number of contexts
+\param img points to the image data, refer to `hldde_next`
+\param stride specifies the distance between a pixel and the pixel
+       on the next row, in bytes.
+\param w is the image width, in pixels
+\param h is the image height, in pixels
+\param results receives `n` ints, the `hldde_next` return value of
+       each context
+\return the number of contexts for which `hldde_next` succeeded
+*/
+int ddeutil_track_batch(TWorkArea** contexts,int n,const void* img,int stride,int w,int h,int* results);
+
+/***************************************************************
+Here go the frame handles. A frame wraps one camera image and
+derives the representations its consumers need on first use: the
+image in the layouts dde_core takes, an 8-bit luminance plane and
+a luminance pyramid. Every consumer of the same frame shares them
+instead of converting the raw pixels again. The pixels are not
+copied, so they must outlive the frame or the next
+`ddeutil_frame_set`.
+`hldde_next` only takes 32-bit pixels, so gray and 24-bit images
+are expanded for the tracker; the detector takes gray images as
+they are, with "is_mono" set. The luminance planes serve the
+motion gate of sessions and callers of `ddeutil_frame_get_gray`.
+dde_core doesn't read them, its detector scans a pyramid of its
+own.
+***************************************************************/
+
+/**
+\brief packed 24-bit BGR with 8 bits per channel, e.g. an OpenCV
+       8UC3 image. It's only understood by ddeutil frames and
+       sessions, don't pass it to dde_core functions.
+*/
+#define DDEUTIL_FLAG_IMAGE_FORMAT_BGR 2
+/**
+\brief packed 24-bit RGB with 8 bits per channel. It's only
+       understood by ddeutil frames and sessions, don't pass it to
+       dde_core functions.
+*/
+#define DDEUTIL_FLAG_IMAGE_FORMAT_RGB 3
+
+/// \brief An opaque frame handle, see `ddeutil_frame_create`
+typedef struct ddeutil_frame ddeutil_frame;
+
+/**
+\brief Create a frame handle for an image
+\param img points to the image data
+\param stride specifies the distance between a pixel and the pixel
+       on the next row, in bytes.
+\param w is the image width, in pixels
+\param h is the image height, in pixels
+\param flags is the image format, FLAG_IMAGE_FORMAT_RGBA,
+       FLAG_IMAGE_FORMAT_GRAYSCALE, DDEUTIL_FLAG_IMAGE_FORMAT_BGR or
+       DDEUTIL_FLAG_IMAGE_FORMAT_RGB. 24-bit images are converted to
+       luminance directly by an AVX2 or SSSE3 kernel picked at run
+       time.
+\return the new frame handle
+*/
+ddeutil_frame* ddeutil_frame_create(const void* img,int stride,int w,int h,int flags);
+/// \brief Destroy a frame handle
+void ddeutil_frame_destroy(ddeutil_frame* f);
+/**
+\brief Rebind a frame handle to the next image. The derived
+       representations are discarded, but their buffers are kept,
+       so a frame reused for a video stream stops allocating memory
+       after the first image. The parameters are the same as
+       `ddeutil_frame_create`.
+*/
+void ddeutil_frame_set(ddeutil_frame* f,const void* img,int stride,int w,int h,int flags);
+/**
+\brief Get a level of the luminance pyramid, building it on first use
+\param f is the frame
+\param level is the pyramid level. Level 0 has the size of the image.
+       Each level above it halves the width and height.
+\param pw receives the width of the level, in pixels
+\param ph receives the height of the level, in pixels
+\param pstride receives the distance between two rows, in bytes
+\return the 8-bit luminance pixels, or NULL if the level would be
+        smaller than 16 pixels on either side or when out of memory
+*/
+const unsigned char* ddeutil_frame_get_gray(ddeutil_frame* f,int level,int* pw,int* ph,int* pstride);
+
+/**
+\brief Run the face detector on a frame, refer to `dde_facedet_run_ex2`
+       for the other parameters. The "is_mono" parameter of `detector`
+       is set from the format of the frame.
+*/
+int ddeutil_facedet_run_frame(void* detector,ddeutil_frame* f,int* ret,int max_faces,int rotation_mode,int detector_type);
+/// \brief Feed a frame to a tracker context, refer to `hldde_next`
+int ddeutil_track_frame(TWorkArea* context,ddeutil_frame* f);
+
+/***************************************************************
+Here go the region-of-interest helpers. When a face covers a small
+part of a large image, the capture pipeline only has to deliver
+the window around the face. `ddeutil_get_roi` tells which window
+to deliver for the next frame, and `ddeutil_track_roi` tracks on
+it. The tracker still sees full-frame geometry, so all results
+stay in full-frame coordinates.
+***************************************************************/
+
+/**
+\brief Get the window to capture for the next frame of a tracked face
+\param context is the tracker context
+\param margin is the extra space around the landmarks on each side,
+       relative to the face size, e.g. 0.5
+\param w is the full image width, in pixels
+\param h is the full image height, in pixels
+\param roi receives 4 ints, x, y, width and height of the window,
+       clipped to the image
+\return 1 on success, 0 if the context holds no landmarks
+*/
+int ddeutil_get_roi(TWorkArea* context,float margin,int w,int h,int* roi);
+
+/**
+\brief Feed a window of an image frame to a tracker context.
+       The window is placed into a full-frame canvas owned by the
+       calling thread, and only the window is copied. Pixels
+       outside the window are a flat gray: when the window moves,
+       what the last one left behind is blanked, so one thread can
+       serve several faces. The face must stay inside the window,
+       use `ddeutil_get_roi` with a generous margin.
+       The canvas takes w*h*4 bytes per calling thread, about 33 MB
+       for a 3840x2160 image. It lives until the thread exits or
+       `ddeutil_track_roi_release` is called.
+\param context is the tracker context
+\param roi_img points to the top-left pixel of the window
+\param roi_stride is the distance between two rows of the window,
+       in bytes
+\param roi is x, y, width and height of the window in the full image
+\param w is the full image width, in pixels
+\param h is the full image height, in pixels
+\param flags is the image format, any format `ddeutil_frame_create`
+       accepts. The canvas holds 32-bit pixels whatever the format.
+\return the return value of `hldde_next`, or 0 if `roi` doesn't fit
+        in the image or the canvas can't be allocated
+*/
+int ddeutil_track_roi(TWorkArea* context,const void* roi_img,int roi_stride,const int* roi,int w,int h,int flags);
+/// \brief Free the `ddeutil_track_roi` canvas of the calling thread
+void ddeutil_track_roi_release();
+
+/***************************************************************
+Here go the context snapshots. A snapshot holds the complete
+tracker state of a context: pose, identity, expression and the
+internal state of the fit. When a face that was lost shows up
+again, restoring its last good snapshot resumes tracking right
+away, instead of converging again from a detection rect.
+A snapshot is a copy of the context memory, which may hold pointers
+into the context itself or into the data loaded by `dde_setup`.
+dde_core doesn't document it, so a snapshot only goes back into
+the context it was saved from, in the same process.
+***************************************************************/
+
+/// \brief Get the number of bytes a snapshot takes
+size_t ddeutil_context_snapshot_size();
+/**
+\brief Save a snapshot of a tracker context, e.g. after a frame with
+       a low face_confirmation_failure_stress.
+\param context is the tracker context
+\param buf receives the snapshot
+\param size is the number of bytes available at `buf`
+\return 1 on success, 0 if `size` is too small or the context holds
+        no face
+*/
+int ddeutil_context_save(TWorkArea* context,void* buf,size_t size);
+/**
+\brief Resume tracking a face from a snapshot, or start over from a
+       detection rect. The snapshot is used when it was saved from
+       `context`, the face detected at `rect` is close to where the
+       snapshot left it and one tracker step on the current image
+       confirms it; otherwise the context is initialized from `rect`,
+       refer to `dde_init_context_ex`.
+\param context is the tracker context
+\param buf is a snapshot saved by `ddeutil_context_save`
+\param rect is the detected face, x0, y0, x1 and y1
+\param img points to the current image, refer to `hldde_next`
+\param stride specifies the distance between a pixel and the pixel
+       on the next row, in bytes.
+\param w is the image width, in pixels
+\param h is the image height, in pixels
+\param rotation_mode is the mode to initialize with, refer to
+       `dde_init_context_ex`
+\return 1 if tracking resumed from the snapshot; the current image
+        has been tracked. 0 if the context was initialized from
+        `rect`; track the current image as usual.
+*/
+int ddeutil_context_restore(TWorkArea* context,const void* buf,const float* rect,const void* img,int stride,int w,int h,int rotation_mode);
+
+/***************************************************************
+Here goes the identity cache. It keeps the identity of each
+returning user, keyed by an opaque user id, and persists the ids
+and identities in a small file. Seeding a new context with a known
+identity needs support from dde_core, which it doesn't have yet.
+Until then, the cache also keeps a snapshot of the context each
+user was stored from, in memory only, and warm-starting a user on
+that same context resumes from it, refer to
+`ddeutil_context_restore`. It works when the user shows up about
+where the snapshot was taken, as in front of a kiosk. Users loaded
+from the file start from the detection rect.
+***************************************************************/
+
+/// \brief An opaque identity cache, see `ddeutil_identity_cache_open`
+typedef struct ddeutil_identity_cache ddeutil_identity_cache;
+
+/**
+\brief Open an identity cache and load its file, if any. A missing or
+       unreadable file, or one with a different number of identity
+       coefficients, gives an empty cache.
+\param path is the cache file, or NULL for a cache in memory only
+\param max_users is the number of users kept. Storing one more
+       evicts the least recently used user. A file with more users
+       loads the most recently used ones.
+\return a new identity cache, or NULL when out of memory
+*/
+ddeutil_identity_cache* ddeutil_identity_cache_open(const char* path,int max_users);
+/// \brief Close an identity cache without saving it
+void ddeutil_identity_cache_close(ddeutil_identity_cache* c);
+/**
+\brief Write the cache to its file. The file is replaced atomically.
+\return 1 on success, 0 on failure
+*/
+int ddeutil_identity_cache_save(ddeutil_identity_cache* c);
+/**
+\brief Store the current state of a face as that of a user. Store it
+       once the face has been tracked confidently for a while, e.g.
+       when its identity gets locked, refer to
+       `ddeutil_session_set_identity_lock`.
+\param c is the identity cache
+\param user_id is the user id, a string of up to 63 characters
+\param context is the tracker context of the user's face
+\return 1 on success, 0 if `user_id` is too long or the context
+        holds no face
+*/
+int ddeutil_identity_cache_store(ddeutil_identity_cache* c,const char* user_id,TWorkArea* context);
+/**
+\brief Get the stored identity of a user, refer to
+       `easydde_get_data`
+\param identity receives N_IDENTITIES floats
+\return 1 on success, 0 if the user is unknown
+*/
+int ddeutil_identity_cache_get_identity(ddeutil_identity_cache* c,const char* user_id,float* identity);
+/**
+\brief Start tracking the face of a user, in place of
+       `dde_init_context_ex`. A user stored from `context` in this
+       process resumes from the stored state, refer to
+       `ddeutil_context_restore`; anyone else starts from `rect`.
+\param c is the identity cache
+\param user_id is the user id
+\param context is the tracker context
+\param rect is the detected face, x0, y0, x1 and y1
+\param img points to the current image, refer to `hldde_next`
+\param stride specifies the distance between a pixel and the pixel
+       on the next row, in bytes.
+\param w is the image width, in pixels
+\param h is the image height, in pixels
+\param rotation_mode is the mode to initialize with, refer to
+       `dde_init_context_ex`
+\return 1 if the stored state was resumed and the current image has
+        been tracked, 0 if the context was initialized from `rect`
+*/
+int ddeutil_identity_cache_warm_start(ddeutil_identity_cache* c,const char* user_id,TWorkArea* context,const float* rect,const void* img,int stride,int w,int h,int rotation_mode);
+
+/***************************************************************
+Here goes the parallel face detector. It has the same parameters
+and results as the dde_core detector, but one call is split into
+tasks that run on a worker pool: the pyramid levels between
+"size_min" and "size_max" are grouped into ranges of about equal
+work, and the ranges with the smallest windows, which dominate the
+cost, are further split into overlapping bands of rows. Each thread
+keeps one dde_core detector and runs its tasks on it; faces found
+by more than one task are reported once.
+***************************************************************/
+
+/// \brief An opaque parallel detector, see `ddeutil_detector_create`
+typedef struct ddeutil_detector ddeutil_detector;
+
+/// \brief Create a parallel face detector
+ddeutil_detector* ddeutil_detector_create();
+/// \brief Destroy a parallel face detector
+void ddeutil_detector_destroy(ddeutil_detector* d);
+/**
+\brief Set a detector parameter.
+\param d is the detector
+\param name is any parameter `dde_facedet_set` accepts, or
+	"n_threads"
+		the number of threads a call is split over. The calling
+		thread is one of them. The default is 1, which passes the
+		call to a single dde_core detector unchanged. Splitting
+		needs "size_min" to be set. While dde_core calls are
+		serialized, the default, the tasks run one at a time and
+		splitting is strictly slower than a single call: only
+		raise it after `ddeutil_set_core_serialization(0)`.
+	"nms_iou"
+		the intersection over union above which two rects are the
+		same face. The default is 0.5.
+	"scan_fraction"
+		the share of the image a call scans, between 0 and 1. The
+		levels and rows are split into tiles of about equal work,
+		and each call runs the next `scan_fraction` of them, so
+		that a full pass is spread over several calls at a bounded
+		cost per call. Tiles a "time_budget_us" drops are the
+		first ones of the next call, so no tile of a pass is
+		skipped. The default is 1, a full scan. Needs
+		"size_min" to be set.
+	"time_budget_us"
+		the time a call may take, in microseconds. The work is
+		split into finer tiles, the tiles around the size and rows
+		of the last face found run first in a full scan, and no
+		tile starts after the budget has expired; the call returns
+		what it found so far. Tiles already running finish, so a
+		call can overrun by about one tile. The default is 0, no
+		budget. Needs "size_min" to be set.
+\param pvalue points to the new parameter value
+\return 1 on success, 0 if too many parameters have been set
+*/
+int ddeutil_detector_set(ddeutil_detector* d,const char* name,const float* pvalue);
+/**
+\brief Run the detector on an image, refer to `dde_facedet_run_ex2`
+       for the parameters and the results.
+\remark Groups of neighboring windows are formed within each task,
+         so a face right at the border of two level ranges can need
+         slightly more evidence than with a single detector.
+*/
+int ddeutil_detector_run(ddeutil_detector* d,const void* img,int stride,int w,int h,int* ret,int max_faces,int rotation_mode,int detector_type);
+
+/// \brief every rotation mode of every detector type, refer to `ddeutil_detector_run_all`
+#define DDEUTIL_DETECT_ALL_MODES 0xfff
+
+/**
+\brief Run the detector for several rotation modes and detector types
+       in one call. All of their tasks go to the worker pool together,
+       so a cold start or an orientation change costs one call instead
+       of up to 12. The same face found in several modes is reported
+       once, refer to `ddeutil_detector_run_scored`.
+\param d is the detector
+\param img points to the image data, refer to `dde_facedet_run_ex2`
+\param stride specifies the distance between a pixel and the pixel
+       on the next row, in bytes.
+\param w is the image width, in pixels
+\param h is the image height, in pixels
+\param ret receives the face rectangles, refer to `dde_facedet_run_ex2`
+\param modes receives one int per face, `rotation_mode+4*detector_type`
+       of the detection. It can be passed to `dde_init_context_ex`
+       as is. It can be NULL.
+\param max_faces indicates the maximum number of faces to detect.
+\param mode_mask selects the modes to try: bit `rotation_mode+4*detector_type`
+       enables that mode. Use DDEUTIL_DETECT_ALL_MODES for all of them.
+\return the number of faces detected
+\remark Each mode still scans its own pyramid inside dde_core, what's
+         shared is a single pass of the worker pool. "min_neighbors"
+         applies to all modes.
+*/
+int ddeutil_detector_run_all(ddeutil_detector* d,const void* img,int stride,int w,int h,int* ret,int* modes,int max_faces,int mode_mask);
+
+/// \brief A detected face with the evidence behind it, see `ddeutil_detector_run_scored`
+typedef struct{
+	/// \brief x, y, width and height, as returned by `dde_facedet_run_ex2`
+	int rect[4];
+	/**
+	\brief the sum of the intersection over union with every detection
+	       of the same face, itself included. Faces found by more
+	       bands, level ranges and modes score higher.
+	*/
+	float score;
+	int rotation_mode;
+	int detector_type;
+	/// \brief the number of detections of the same face, itself included
+	int n_neighbors;
+}ddeutil_face_rect;
+
+/**
+\brief Run the detector and rank the faces. Detections of the same
+       face, i.e. overlapping by more than "nms_iou", vote for each
+       other; the best scoring one of each face is kept and the rest
+       are suppressed. The results are sorted by score, so the first
+       one is the best candidate to pass to `dde_init_context_ex` with
+       `rotation_mode+4*detector_type`.
+\param d is the detector
+\param img points to the image data, refer to `dde_facedet_run_ex2`
+\param stride specifies the distance between a pixel and the pixel
+       on the next row, in bytes.
+\param w is the image width, in pixels
+\param h is the image height, in pixels
+\param ret receives up to `max_faces` faces
+\param max_faces indicates the maximum number of faces to detect.
+\param mode_mask selects the modes to try, refer to
+       `ddeutil_detector_run_all`
+\return the number of faces detected
+\remark dde_core doesn't expose its cascade scores or neighbor counts,
+         so the evidence is what the detector tasks agree on.
+*/
+int ddeutil_detector_run_scored(ddeutil_detector* d,const void* img,int stride,int w,int h,ddeutil_face_rect* ret,int max_faces,int mode_mask);
+
+/***************************************************************
+Here go the tracking sessions. A session bundles everything the
+`easydde` and `easymultiface` functions keep in process-wide
+globals: its own face detector, random number generator and
+tracker contexts. Sessions don't share any state with each other
+or with the `easydde` / `easymultiface` functions, so one process
+can serve as many camera streams as it has sessions.
+***************************************************************/
+
+/// \brief the maximum number of faces a single session can track
+#define DDEUTIL_MAX_FACES 32
+
+/**
+\brief refine every tracked face with `ddear_run_optical_flow` in
+       `ddeutil_session_run`. It's a ddeutil-only flag and is never
+       passed to dde_core.
+*/
+#define DDEUTIL_FLAG_RUN_OPTICAL_FLOW 0x100
+
+/// \brief An opaque tracking session, see `ddeutil_session_create`
+typedef struct ddeutil_session ddeutil_session;
+
+/**
+\brief Create a tracking session
+\param max_faces is the maximum number of faces to track, between 1
+       and DDEUTIL_MAX_FACES. Use 1 for an `easydde`-like session.
+       The tracker contexts of all faces are allocated up front, in
+       one block where each context starts on a cache line of its
+       own. A face entering or leaving only claims or releases a
+       slot, it never allocates.
+\return the new session, or NULL when out of memory
+*/
+ddeutil_session* ddeutil_session_create(int max_faces);
+/// \brief Destroy a session and all of its tracker contexts
+void ddeutil_session_destroy(ddeutil_session* s);
+
+/**
+\brief Feed an image frame to a session. It's the per-session
+       counterpart of `easymultiface_run`.
+\param s is the session
+\param p_invalidation_mask receives a bitmask of the faces lost in
+       this frame, refer to `easymultiface_run` for details. It can
+       be NULL.
+\param img points to the image data, in any format
+       `ddeutil_frame_create` accepts
+\param stride specifies the distance between a pixel and the pixel
+       on the next row, in bytes.
+\param w is the image width, in pixels
+\param h is the image height, in pixels
+\param flags packs the image format and the options
+       FLAG_DISABLE_ROTATION, FLAG_DISABLE_SIDE_FACE and
+       DDEUTIL_FLAG_RUN_OPTICAL_FLOW. The session sets the "is_mono"
+       detector parameter from the format on every detection.
+\return A bitmask of faces with valid, updated results in this frame.
+        The face ids are consistent across frames, refer to
+        `easymultiface_run` for details.
+*/
+int ddeutil_session_run(ddeutil_session* s, int* p_invalidation_mask, const void* img,int stride,int w,int h,int flags);
+
+/**
+\brief Feed a frame handle to a session. It's the same as
+       `ddeutil_session_run`, except that the image comes from `frame`,
+       whose derived representations are shared with any other
+       consumer of the frame.
+*/
+int ddeutil_session_run_frame(ddeutil_session* s, int* p_invalidation_mask, ddeutil_frame* frame,int flags);
+
+/**
+\brief Set the number of threads `ddeutil_session_run` uses to track
+       faces. Each face's tracker step, plus its optical flow
+       refinement when requested, is one task; idle threads pick up
+       the remaining faces, so a frame with several faces costs about
+       as much as its slowest face. The calling thread is one of the
+       `n_threads`. The default is 1, i.e. no extra threads.
+\remark The tasks still take turns while dde_core calls are
+        serialized, refer to `ddeutil_set_core_serialization`.
+\param s is the session
+\param n_threads is the new number of threads
+\return the previous number of threads
+*/
+int ddeutil_session_set_n_threads(ddeutil_session* s,int n_threads);
+
+/**
+\brief Get the detector of a session, e.g. to set its "n_threads".
+       The session sets "size_min" and "min_neighbors" itself before
+       every detection attempt. With a "scan_fraction" below 1, the
+       search for new faces is spread over several frames and the
+       detector schedule advances once per full pass.
+*/
+ddeutil_detector* ddeutil_session_get_detector(ddeutil_session* s);
+
+/**
+\brief Get the tracker context of a face
+\param s is the session
+\param face_id is the face id
+\return the context, or NULL if `face_id` is not below the maximum
+        number of faces
+*/
+TWorkArea* ddeutil_session_get_context(ddeutil_session* s,int face_id);
+/**
+\brief Get the values of face parameter `name`. It's the per-session
+       counterpart of `easydde_get_data`.
+\param s is the session
+\param face_id is the face id
+\param ret receives up to `szret` floats. It can be NULL when `szret`
+       is 0.
+\param szret is the number of floats available at `ret`
+\param name is the parameter name, refer to `easydde_get_data`
+\return the number of floats available for `name`, or 0 if the face
+        is not being tracked
+*/
+int ddeutil_session_get_data(ddeutil_session* s,int face_id,float* ret,int szret,const char* name);
+/**
+\brief Set the number of times the tracker is run for each face and
+       frame, the per-session counterpart of
+       `easydde_set_default_n_copies`. Each face runs `copies_min`
+       copies, then more as long as its
+       face_confirmation_failure_stress stays above 1 or the last
+       copy hasn't converged, refer to `ddeutil_session_set_tolerance`,
+       up to `copies_max`. A steady face costs one copy, a fast or
+       hard one gets the extra copies it needs. The default is 1 and 1.
+\param s is the session
+\param copies_min is the number of copies every face runs
+\param copies_max is the number of copies a face may escalate to.
+       Set it to `copies_min` for a fixed number of copies.
+\return 1
+*/
+int ddeutil_session_set_n_copies(ddeutil_session* s,int copies_min,int copies_max);
+/**
+\brief Set when a tracker copy has converged. The update of a copy is
+       the root mean square displacement of the landmarks it moved,
+       relative to the face width. Once it falls below `tolerance`,
+       further copies would hardly change the result and are skipped.
+\param s is the session
+\param tolerance is the update below which a face has converged. The
+       default is 0.02.
+\return 1
+*/
+int ddeutil_session_set_tolerance(ddeutil_session* s,float tolerance);
+/**
+\brief Get the number of tracker copies a face ran on the last frame
+\return the number of copies, or 0 if the face is not being tracked
+*/
+int ddeutil_session_get_n_copies(ddeutil_session* s,int face_id);
+/**
+\brief Freeze the identity of faces that have converged, so that the
+       tracker mostly fits pose and expression. Once the "identity"
+       coefficients of a face have changed by less than `tolerance`
+       (Euclidean norm) on each of `n_frames` consecutive frames, the
+       session sets the "w_smooth_identity" tweak of its context to
+       `w_locked`. As soon as its face_confirmation_failure_stress
+       rises above 1, or the slot gets a new face, it is set back to
+       `w_unlocked`.
+\param s is the session
+\param tolerance is the largest change of a converged identity. 0
+       turns the lock off, which is the default.
+\param n_frames is the number of frames the identity must hold
+\param w_locked is the "w_smooth_identity" value of a locked face
+\param w_unlocked is the "w_smooth_identity" value of a free face
+\return 1
+\remark "w_smooth_identity" is a `dde_set` tweak, consult support for
+         the values suiting your dde_core build.
+*/
+int ddeutil_session_set_identity_lock(ddeutil_session* s,float tolerance,int n_frames,float w_locked,float w_unlocked);
+/// \brief Returns a bitmask of the faces whose identity is locked
+int ddeutil_session_get_identity_locked(ddeutil_session* s);
+/// \brief Returns a bitmask of the faces currently being tracked
+int ddeutil_session_hasface(ddeutil_session* s);
+/**
+\brief Discard all current results and restart the session from
+       scratch, refer to `easydde_reset`.
+*/
+void ddeutil_session_reset(ddeutil_session* s);
+/**
+\brief Set the maximum number of faces a session tracks, refer to
+       `easymultiface_set_max_faces`. Going above the number of
+       contexts allocated so far allocates a new block for all of
+       them, and the faces being tracked start over; set it once
+       before tracking. Going below drops the faces with larger ids.
+\param s is the session
+\param max_faces is the new maximum, between 1 and DDEUTIL_MAX_FACES
+\return the previous maximum, or 0 when the new block can't be
+        allocated. The session then keeps its maximum and its faces.
+*/
+int ddeutil_session_set_max_faces(ddeutil_session* s,int max_faces);
+/**
+\brief Stop tracking a face, e.g. one that has left the area of
+       interest. Its slot is free for the next face found.
+\return 1 if the face was being tracked, 0 otherwise
+*/
+int ddeutil_session_drop_face(ddeutil_session* s,int face_id);
+
+/**
+\brief a deterministic detector schedule that sweeps through every
+       rotation mode, detector type and size_min bin, refer to
+       `ddeutil_session_set_schedule`
+*/
+#define DDEUTIL_SCHEDULE_SWEEP 0
+/**
+\brief the randomized detector schedule of the `easydde` functions,
+       refer to `dde_facedet_set`
+*/
+#define DDEUTIL_SCHEDULE_RANDOM 1
+
+/**
+\brief Choose how the session varies the detector parameters between
+       frames while it looks for faces.
+       With DDEUTIL_SCHEDULE_SWEEP, the rotation mode changes every
+       attempt, starting from the orientation of the last face found;
+       the detector type cycles frontal, right, frontal, left; and
+       size_min steps through 4 bins of the randomized range. Every
+       combination is tried within 64 detection attempts, 16 with
+       either FLAG_DISABLE_ROTATION or FLAG_DISABLE_SIDE_FACE, and 4
+       with both. Later sweeps fill the size_min bins
+       with a low-discrepancy sequence, so runs are reproducible.
+       DDEUTIL_SCHEDULE_SWEEP is the default.
+\param s is the session
+\param schedule is DDEUTIL_SCHEDULE_SWEEP or DDEUTIL_SCHEDULE_RANDOM
+\return the previous schedule
+*/
+int ddeutil_session_set_schedule(ddeutil_session* s,int schedule);
+/**
+\brief Seed the random number generator of a session and restart its
+       detector schedule. Sessions with the same seed fed the same
+       frames make the same detector calls.
+\param s is the session
+\param seed is the new seed
+*/
+void ddeutil_session_seed(ddeutil_session* s,unsigned int seed);
+
+/**
+\brief Get the face orientation detected most recently, refer to
+       `easydde_get_rotation_mode`.
+\return A number that is 0, 1, 2, or 3.
+*/
+int ddeutil_session_get_rotation_mode(ddeutil_session* s);
+/**
+\brief Set the face orientation the session tries first, refer to
+       `easydde_set_default_orientation`.
+\param rmode is a number that is 0, 1, 2, or 3.
+*/
+void ddeutil_session_set_default_orientation(ddeutil_session* s,int rmode);
+
+/**
+\brief Only look for new faces where the image has changed. The
+       session compares each frame with the previous one in blocks
+       of 4x4 pixels on a coarse pyramid level, about 32x32 pixels of
+       a 640x480 image, and the detector only scans the bounding box
+       of the blocks that changed in the last `history` frames, grown
+       by the largest window the detector scans with, so that any face
+       reaching into them is inside the box. Frames where nothing
+       changed run no detector at all. The gate is off by default.
+\remark The largest window is the "size_max" of the session's
+       detector, and the smaller side of the image while it isn't
+       set, in which case every scan covers the whole image. Set
+       "size_max" to the largest face expected to keep the scans
+       small. A partial scan, refer to "scan_fraction", finishes on
+       the box it started on.
+\param s is the session
+\param threshold is the mean absolute luminance difference above
+       which a block has changed, e.g. 8. 0 turns the gate off.
+\param history is the number of frames a changed block stays in the
+       scan
+\param full_scan_period forces a full scan every that many frames,
+       to catch faces that keep perfectly still. 0 never forces one.
+*/
+void ddeutil_session_set_motion_gate(ddeutil_session* s,int threshold,int history,int full_scan_period);
+
+/***************************************************************
+Here go the threading controls. dde_core doesn't document whether
+`hldde_next`, `dde_get` and the detector may run concurrently on
+distinct contexts. To stay on the safe side, every call the
+ddeutil functions make into dde_core is serialized by a single
+process-wide lock by default. Run `ddeutil_probe_reentrancy` of
+bench/ddeutil_probes.h on the dde_core build you ship with; once it
+passes, the lock can be turned off and sessions on different
+threads run in parallel.
+***************************************************************/
+
+/**
+\brief Enable or disable the process-wide lock around dde_core calls.
+       Only change it while no other thread is inside a ddeutil
+       function.
+\param enable is 1 to serialize dde_core calls, 0 to allow
+       concurrent calls on distinct contexts and detectors
+\return the previous setting
+*/
+int ddeutil_set_core_serialization(int enable);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
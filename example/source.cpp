@@ -1,9 +1,12 @@
 #include <cstdio>
 #include <cstring>
 #include "../ddeface.h"
+#include "../ddeutil.h"
 #include "include/authpack.h"
 
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 
 #include "include/opencv/cv.h"
 #include "include/opencv/highgui.h"
@@ -11,29 +14,18 @@ using namespace cv;
 
 float expression_data[46], rotation_data[4], failure_data[2], pupil_pos[2], landmarks[150];
 
-float* g_global_tables = NULL;
-
 bool faceinit(){
-	int sz;
-	FILE *f = fopen("../assets/v3.bin", "rb");
-	if (!f) return false;
-	fseek(f, 0, SEEK_END);
-	sz = ftell(f);
-	fseek(f, 0, SEEK_SET);
-	float *g_global_tables = (float*)malloc(sz);
-	fread(g_global_tables, 1, sz, f);
-	fclose(f);
-	
-	dde_setup((void*)g_global_tables, g_auth_package, sizeof(g_auth_package));
-	//dde_setup((void*)g_global_tables, NULL, 0);
+	// v3.bin is mapped rather than read, the tables are used in place
+	if (ddeutil_setup_from_file("../assets/v3.bin", g_auth_package, sizeof(g_auth_package)) < 0) return false;
+	//ddeutil_setup_from_file("../assets/v3.bin", NULL, 0);
 	return true;
 }
 
-bool ddefaceExample(unsigned int* img_raw, int w, int h) {
+bool ddefaceExample(const unsigned char* img_gray, int stride, int w, int h) {
 	int is_valid = 0, rotate = 0;
 	easydde_reset();  // hide this line when tracking in a video.
 	for (int i = 0; i < 64; i++) {
-		is_valid = easydde_run(img_raw, w, h, 0);
+		is_valid = easydde_run_ex(img_gray, stride, w, h, FLAG_IMAGE_FORMAT_GRAYSCALE);
 		if (is_valid > 0 && i >= 60) {
 			rotate = i % 4;
 			break;
@@ -148,25 +140,20 @@ int main() {
 			continue;
 		}
 
-		unsigned int *imagedata = (unsigned int *)malloc(img->width*img->height*4);
-		char tmp[4];
+		// the tracker only needs luminance, convert the BGR pixels directly
 		int step = img->widthStep / sizeof(uchar);
-		for (int i = 0; i<img->height; i++)
-			for (int j = 0; j < img->width; j++) {
-				int r = img->imageData[i*step + j * 3 + 2] & 0xff;
-				int g = img->imageData[i*step + j * 3 + 1] & 0xff;
-				int b = img->imageData[i*step + j * 3] & 0xff;
-				int a = 0xff;
-
-				imagedata[(i)*img->width + j] = (a << 24) + (b << 16) + (g << 8) + r;
-			}
+		ddeutil_frame *frame = ddeutil_frame_create(img->imageData, step, img->width, img->height, DDEUTIL_FLAG_IMAGE_FORMAT_BGR);
+		int gray_stride;
+		const unsigned char *gray = ddeutil_frame_get_gray(frame, 0, NULL, NULL, &gray_stride);
 
 		printf("Run FaceUnity sdk\n ...\n");
 		int run_times = 5, valid = 0;
 		while (!valid && run_times) {
-			valid = ddefaceExample(imagedata, img->width, img->height);
+			valid = ddefaceExample(gray, gray_stride, img->width, img->height);
 			run_times--;
 		}
+		ddeutil_frame_destroy(frame);
+		frame = NULL;
 		if (!valid) {
 			alive = 2;
 			continue;
@@ -195,9 +182,6 @@ int main() {
 		cvDestroyWindow("landmarks");
 		cvSaveImage("saveImage.jpg", img);
 
-		free(imagedata);
-		imagedata = NULL;
-
 		printf("Output model\n ...\n");
 		strcpy(name, "model/"); strcat(name, modelname); strcat(name, "-output.obj");
 		fout = fopen(name, "w");